@@ -7,6 +7,7 @@
 //========================================================//
 
 #include "cache.h"
+#include <inttypes.h>
 #include <stdio.h>
 
 //
@@ -32,9 +33,12 @@ uint32_t l2cacheSets;    // Number of sets in the L2$
 uint32_t l2cacheAssoc;   // Associativity of the L2$
 uint32_t l2cacheHitTime; // Hit Time of the L2$
 uint32_t inclusive;      // Indicates if the L2 is inclusive
+uint32_t writeThrough;   // Indicates if stores write through to the next level
+uint32_t writeAllocate;  // Indicates if store misses allocate a block
 
 uint32_t blocksize;      // Block/Line size
 uint32_t memspeed;       // Latency of Main Memory
+uint32_t numCores;       // Number of cores with private I$ and D$
 
 //------------------------------------//
 //          Cache Statistics          //
@@ -47,22 +51,52 @@ uint64_t icachePenalties;  // I$ penalties
 uint64_t dcacheRefs;       // D$ references
 uint64_t dcacheMisses;     // D$ misses
 uint64_t dcachePenalties;  // D$ penalties
+uint64_t dcacheStores;     // D$ stores
+uint64_t dcacheWritebacks; // D$ dirty blocks written back
+uint64_t dcacheWritebackPenalties; // D$ penalties of writebacks
 
 uint64_t l2cacheRefs;      // L2$ references
 uint64_t l2cacheMisses;    // L2$ misses
 uint64_t l2cachePenalties; // L2$ penalties
+uint64_t l2cacheWritebacks; // L2$ dirty blocks written back
+uint64_t l2cacheWritebackPenalties; // L2$ penalties of writebacks
+
+uint64_t memReads;         // Blocks read from main memory
+uint64_t memWrites;        // Blocks written to main memory
+
+CoreStats * coreStats;     // Per-core I$ and D$ statistics
+
+#ifdef ADDR64
+uint64_t maxTraceAddr = UINT64_MAX;
+#endif
 
 //------------------------------------//
 //        Cache Data Structures       //
 //------------------------------------//
 uint32_t numBlockBits;
-uint32_t blockMask;
+addr_t blockMask;
+
+#ifdef ADDR64
+// Only the low TAG_BITS bits of the tag are kept so that a block stays 8
+// bytes.  The set holding a block supplies the rest of its address.
+#define TAG_BITS 54
+#define TAG_MASK (((addr_t)1 << TAG_BITS) - 1)
 
 typedef struct CacheBlock {
-  uint32_t address;
+  uint64_t tag   : TAG_BITS;
+  uint64_t lru   : 8;
+  uint64_t valid : 1;
+  uint64_t dirty : 1;
+} CacheBlock;
+#else
+// The whole block address serves as the tag
+typedef struct CacheBlock {
+  uint32_t tag;
   uint8_t lru;
   uint8_t valid;
+  uint8_t dirty;
 } CacheBlock;
+#endif
 
 typedef struct CacheSet {
   uint8_t numValid;
@@ -75,12 +109,21 @@ typedef struct Cache {
   CacheSet * sets;
 } Cache;
 
+// The I$ and D$ of the selected core
 Cache * ICache;
 Cache * DCache;
 Cache * L2Cache;
 uint32_t iSetMask;
 uint32_t dSetMask;
 uint32_t l2SetMask;
+uint32_t iTagShift;   // Bit at which the tags of each cache start
+uint32_t dTagShift;
+uint32_t l2TagShift;
+
+// The private I$ and D$ of every core
+Cache ** ICaches;
+Cache ** DCaches;
+uint32_t currentCore;
 
 //------------------------------------//
 //          Cache Functions           //
@@ -124,6 +167,13 @@ init_cache()
   l2cacheRefs       = 0;
   l2cacheMisses     = 0;
   l2cachePenalties  = 0;
+  dcacheStores      = 0;
+  dcacheWritebacks  = 0;
+  dcacheWritebackPenalties  = 0;
+  l2cacheWritebacks = 0;
+  l2cacheWritebackPenalties = 0;
+  memReads          = 0;
+  memWrites         = 0;
   
   numBlockBits = 0;
 
@@ -131,14 +181,25 @@ init_cache()
   while (blocksize >> numBlockBits != 1)
     numBlockBits += 1;
   
-  blockMask = (-1 << numBlockBits);
+  blockMask = ((addr_t)-1 << numBlockBits);
 
   //
   //TODO: Initialize Cache Simulator Data Structures
   //
 
-  ICache = createCache(icacheSets, icacheAssoc);
-  DCache = createCache(dcacheSets, dcacheAssoc);
+  if (numCores == 0) {
+    numCores = 1;
+  }
+  ICaches = (Cache **) calloc(numCores, sizeof(Cache *));
+  DCaches = (Cache **) calloc(numCores, sizeof(Cache *));
+  coreStats = (CoreStats *) calloc(numCores, sizeof(CoreStats));
+  for (int i = 0; i < numCores; i++) {
+    ICaches[i] = createCache(icacheSets, icacheAssoc);
+    DCaches[i] = createCache(dcacheSets, dcacheAssoc);
+  }
+  currentCore = 0;
+  ICache = ICaches[0];
+  DCache = DCaches[0];
   L2Cache = createCache(l2cacheSets, l2cacheAssoc);
 
   uint32_t sets = 0;
@@ -147,6 +208,7 @@ init_cache()
       sets += 1;
     iSetMask = ~(-1 << sets);
   }
+  iTagShift = numBlockBits + sets;
 
   sets = 0;
   if (dcacheSets > 0) {
@@ -154,6 +216,7 @@ init_cache()
       sets += 1;
     dSetMask = ~(-1 << sets);
   }
+  dTagShift = numBlockBits + sets;
 
   sets = 0;
   if (l2cacheSets > 0) {
@@ -161,6 +224,92 @@ init_cache()
       sets += 1;
     l2SetMask = ~(-1 << sets);
   }
+  l2TagShift = numBlockBits + sets;
+
+#ifdef ADDR64
+  // The cache with the fewest set bits has the widest tags
+  uint32_t minTagShift = 64;
+  if (icacheSets > 0 && iTagShift < minTagShift)
+    minTagShift = iTagShift;
+  if (dcacheSets > 0 && dTagShift < minTagShift)
+    minTagShift = dTagShift;
+  if (l2cacheSets > 0 && l2TagShift < minTagShift)
+    minTagShift = l2TagShift;
+
+  maxTraceAddr = UINT64_MAX;
+  if (minTagShift + TAG_BITS < 64) {
+    maxTraceAddr = ((uint64_t)1 << (minTagShift + TAG_BITS)) - 1;
+  }
+#endif
+}
+
+addr_t
+wide_addr_error(uint64_t addr)
+{
+#ifdef ADDR64
+  fprintf(stderr,"Input Error address 0x%" PRIx64 " has a tag wider than the "
+      "%d bits cache64 keeps; use larger blocks or more sets\n", addr, TAG_BITS);
+#else
+  fprintf(stderr,"Input Error address 0x%" PRIx64 " is wider than 32 bits, "
+      "run cache64 (make cache64) on this trace\n", addr);
+#endif
+  exit(1);
+}
+
+// Make 'core' the core whose I$ and D$ serve icache_access and
+// dcache_access.  The I$/D$ counters of the previously selected core are
+// saved to coreStats and those of 'core' are loaded in their place.
+//
+void
+select_core(uint32_t core)
+{
+  CoreStats * stats = coreStats + currentCore;
+  stats->icacheRefs      = icacheRefs;
+  stats->icacheMisses    = icacheMisses;
+  stats->icachePenalties = icachePenalties;
+  stats->dcacheRefs      = dcacheRefs;
+  stats->dcacheMisses    = dcacheMisses;
+  stats->dcachePenalties = dcachePenalties;
+  stats->dcacheStores    = dcacheStores;
+  stats->dcacheWritebacks = dcacheWritebacks;
+  stats->dcacheWritebackPenalties = dcacheWritebackPenalties;
+
+  currentCore = core;
+  stats = coreStats + core;
+  icacheRefs      = stats->icacheRefs;
+  icacheMisses    = stats->icacheMisses;
+  icachePenalties = stats->icachePenalties;
+  dcacheRefs      = stats->dcacheRefs;
+  dcacheMisses    = stats->dcacheMisses;
+  dcachePenalties = stats->dcachePenalties;
+  dcacheStores    = stats->dcacheStores;
+  dcacheWritebacks = stats->dcacheWritebacks;
+  dcacheWritebackPenalties = stats->dcacheWritebackPenalties;
+
+  ICache = ICaches[core];
+  DCache = DCaches[core];
+}
+
+// Load the sum of the per-core statistics into the I$/D$ counters.
+// The counters of the selected core must have been saved by select_core.
+//
+void
+collect_core_stats()
+{
+  icacheRefs = icacheMisses = icachePenalties = 0;
+  dcacheRefs = dcacheMisses = dcachePenalties = 0;
+  dcacheStores = dcacheWritebacks = dcacheWritebackPenalties = 0;
+  for (int i = 0; i < numCores; i++) {
+    icacheRefs      += coreStats[i].icacheRefs;
+    icacheMisses    += coreStats[i].icacheMisses;
+    icachePenalties += coreStats[i].icachePenalties;
+    dcacheRefs      += coreStats[i].dcacheRefs;
+    dcacheMisses    += coreStats[i].dcacheMisses;
+    dcachePenalties += coreStats[i].dcachePenalties;
+    dcacheStores    += coreStats[i].dcacheStores;
+    dcacheWritebacks += coreStats[i].dcacheWritebacks;
+    dcacheWritebackPenalties += coreStats[i].dcacheWritebackPenalties;
+  }
 }
 
 // Returns the set location in the cache of the address
@@ -174,6 +323,26 @@ uint32_t getSetBits(uint32_t addr, uint32_t numBlockBits, uint32_t numSets) {
   return (addr >> numBlockBits) & setBitMask;
 }
 
+// Returns the tag kept for the block holding addr in a cache whose tags
+// start at bit 'shift'
+static inline addr_t blockTag(addr_t addr, uint32_t shift) {
+#ifdef ADDR64
+  return (addr >> shift) & TAG_MASK;
+#else
+  return addr & blockMask;
+#endif
+}
+
+// Returns the address of the block kept as 'tag' in set 'setIndex' of a
+// cache whose tags start at bit 'shift'
+static inline addr_t tagAddress(addr_t tag, addr_t setIndex, uint32_t shift) {
+#ifdef ADDR64
+  return (tag << shift) | (setIndex << numBlockBits);
+#else
+  return tag;
+#endif
+}
+
 void updateBlocksLRUHit(CacheBlock * blocks, uint32_t numBlocks, uint32_t blockHitLRU) {
   for (int i = 0; i < numBlocks; i++) {
     
@@ -187,73 +356,95 @@ void updateBlocksLRUHit(CacheBlock * blocks, uint32_t numBlocks, uint32_t blockH
   }
 }
 
-// Increases the lru of all the blocks by 1 then inserts the new address at the LRU block
-void updateBlocksLRUMiss(CacheBlock * blocks, uint32_t numBlocks, uint32_t addr) {
+// Increases the lru of all the blocks by 1 then inserts the new tag at the LRU block
+// Returns the block now holding tag, the evicted block is copied to evicted
+CacheBlock * updateBlocksLRUMiss(CacheBlock * blocks, uint32_t numBlocks, addr_t tag,
+                                 CacheBlock * evicted) {
+  CacheBlock * filled = NULL;
+
   for (int i = 0; i < numBlocks; i++) {
     blocks[i].lru++;
     if (blocks[i].lru == numBlocks) {
+      *evicted = blocks[i];
       blocks[i].lru = 0;
-      blocks[i].address = addr;
+      blocks[i].tag = tag;
+      blocks[i].dirty = 0;
+      filled = blocks + i;
     }
   }
+
+  return filled;
 }
 
-// Increases the lru of all the blocks by 1 then inserts the new address at the LRU block
-void updateBlocksLRUInclusive(CacheBlock * blocks, uint32_t addr) {
-  CacheBlock * iblocks = NULL;
-  if( icacheSets ) {
-    iblocks = ICache->sets[(addr>>numBlockBits) & iSetMask].blocks; 
-  }
-  CacheBlock * dblocks = NULL;
-  if( dcacheSets ) {
-    dblocks = DCache->sets[(addr>>numBlockBits) & dSetMask].blocks; 
+// Invalidates the block holding tag in the given set of an L1 cache
+// Returns 1 if the invalidated block was dirty
+uint32_t invalidateL1Block(CacheSet * set, uint32_t assoc, addr_t tag) {
+  CacheBlock * blocks = set->blocks;
+  uint32_t dirty = 0;
+
+  // check if block to evict is present in l1 cache
+  for (int j = 0; j < assoc; j++) {
+    if (blocks[j].tag == tag) {
+      dirty |= blocks[j].dirty;
+      blocks[j].valid = 0;
+      blocks[j].dirty = 0;
+      uint8_t lru_temp = blocks[j].lru;
+      // before we invalidate, update the lru of all the blocks w/ greater lru by -1
+      for (int k = 0; k < assoc; k++) {
+        if (blocks[k].lru > lru_temp)
+          blocks[k].lru--;
+      }
+
+      set->numValid--;
+    }
   }
+
+  return dirty;
+}
+
+// Increases the lru of all the blocks by 1 then inserts the new address at the LRU block
+// Returns the block now holding addr, the evicted block is copied to evicted and
+// counts as dirty if any L1 copy of it was
+CacheBlock * updateBlocksLRUInclusive(CacheBlock * blocks, addr_t addr,
+                                      CacheBlock * evicted) {
+  CacheBlock * filled = NULL;
   uint32_t temp = 0;
+  addr_t tag = blockTag(addr, l2TagShift);
 
   for (int i = 0; i < l2cacheAssoc; i++) {
     blocks[i].lru++;
     if (blocks[i].lru == l2cacheAssoc) {
       temp++;
-      
-      if (iblocks != NULL) {
-          // check if block to evict is present in l1 cache
-          for (int j = 0; j < icacheAssoc; j++) {
-            if (iblocks[j].address == blocks[i].address) {
-              iblocks[j].valid = 0;
-              uint8_t lru_temp = iblocks[j].lru;
-              // before we invalidate, update the lru of all the blocks w/ greater lru by -1
-              for (int k = 0; k < icacheAssoc; k++) {
-                if (iblocks[k].lru > lru_temp)
-                  iblocks[k].lru--;
-              }
-
-              ICache->sets[(addr>>numBlockBits) & iSetMask].numValid--;
-            }
-          }
-      }
-      if (dblocks != NULL) {
-          for (int j = 0; j < dcacheAssoc; j++) {
-            if (dblocks[j].address == blocks[i].address) {
-              dblocks[j].valid = 0;
-              uint8_t lru_temp = dblocks[j].lru;
-              // before we invalidate, update the lru of all the blocks w/ greater lru by -1
-              for (int k = 0; k < dcacheAssoc; k++) {
-                if (dblocks[k].lru > lru_temp)
-                  dblocks[k].lru--;
-              }
-
-              DCache->sets[(addr>>numBlockBits) & dSetMask].numValid--;
-            }
-          }
+      *evicted = blocks[i];
+
+      // the evicted block may be held by the L1s of every core, in the set
+      // its own address maps to
+      addr_t evictedAddr = tagAddress(blocks[i].tag, (addr>>numBlockBits) & l2SetMask,
+                                      l2TagShift);
+      for (int c = 0; c < numCores; c++) {
+        if (icacheSets) {
+          evicted->dirty |=
+            invalidateL1Block(ICaches[c]->sets + ((evictedAddr>>numBlockBits) & iSetMask),
+                              icacheAssoc, blockTag(evictedAddr, iTagShift));
+        }
+        if (dcacheSets) {
+          evicted->dirty |=
+            invalidateL1Block(DCaches[c]->sets + ((evictedAddr>>numBlockBits) & dSetMask),
+                              dcacheAssoc, blockTag(evictedAddr, dTagShift));
+        }
       }
 
       blocks[i].lru = 0;
-      blocks[i].address = addr;
+      blocks[i].tag = tag;
+      blocks[i].dirty = 0;
+      filled = blocks + i;
     }
   }
   if (temp > 1) {
     printf("Error in updateBlocksLRU");
   }
+
+  return filled;
 }
 
 uint32_t allBlocksValid (CacheBlock * blocks, uint32_t numBlocks) {
@@ -266,97 +457,236 @@ uint32_t allBlocksValid (CacheBlock * blocks, uint32_t numBlocks) {
   return 1;
 }
 
+// Looks up tag in the blocks of a set and updates the LRU on a hit
+// Returns the block holding tag, or NULL on a miss
+static inline CacheBlock * probeBlocks(CacheBlock * blocks, uint32_t assoc, addr_t tag) {
+  // check if addr exists in cache
+  for (int i = 0; i < assoc; i++) {
+
+    CacheBlock blockToCheck = blocks[i];
+    if (blockToCheck.valid == 1 && blockToCheck.tag == tag) {
+            // update LRU of blocks on hit
+            updateBlocksLRUHit(blocks, assoc, blockToCheck.lru);
+
+            return blocks + i;
+          }
+  }
+
+  return NULL;
+}
+
+// Brings tag into a set that still has an invalid block
+// Returns the block now holding tag
+static inline CacheBlock * fillInvalidBlock(CacheSet * set, uint32_t assoc, addr_t tag) {
+  CacheBlock * blocks = set->blocks;
+
+  set->numValid++;
+  // replace the first invalid block with the new block and mark it valid
+  for (int i = 0; i < assoc; i++) {
+    CacheBlock * checkedBlock = blocks + i;
+
+    if (checkedBlock->valid == 0) {
+      checkedBlock->valid = 1;
+      checkedBlock->dirty = 0;
+      checkedBlock->tag = tag;
+
+      for (int j = 0; j < assoc; j++) {
+        blocks[j].lru++;
+      }
+      checkedBlock->lru = 0;
+
+      return checkedBlock;
+    }
+  }
+
+  return NULL;
+}
+
+// Brings tag into a set of an L1 cache, evicting the LRU block if the set is full
+// Returns the block now holding tag, evicted->dirty is set if a dirty block was evicted
+static inline CacheBlock * fillL1Block(CacheSet * set, uint32_t assoc, addr_t tag,
+                                       CacheBlock * evicted) {
+  evicted->dirty = 0;
+  if (set->numValid == assoc) {
+    return updateBlocksLRUMiss(set->blocks, assoc, tag, evicted);
+  }
+  else {
+    return fillInvalidBlock(set, assoc, tag);
+  }
+}
+
+// Read a block from main memory
+// Return the access time
+static inline uint32_t
+memory_read()
+{
+  memReads++;
+  return memspeed;
+}
+
+// Write a block to main memory
+// Return the access time
+static inline uint32_t
+memory_write()
+{
+  memWrites++;
+  return memspeed;
+}
+
+// Brings addr into the given set of the l2cache from main memory, writing
+// back the evicted block if it was dirty
+// Return the penalty of the fill
+static uint32_t
+l2cache_fill(CacheSet * set, addr_t addr, CacheBlock ** filled)
+{
+  CacheBlock evicted;
+  addr_t tag = blockTag(addr, l2TagShift);
+  evicted.dirty = 0;
+
+  // bring the value into the l2 cache
+  if (set->numValid == l2cacheAssoc) {
+    if (inclusive) {
+      *filled = updateBlocksLRUInclusive(set->blocks, addr, &evicted);
+    }
+    else {
+      *filled = updateBlocksLRUMiss(set->blocks, l2cacheAssoc, tag, &evicted);
+    }
+  }
+  else {
+    *filled = fillInvalidBlock(set, l2cacheAssoc, tag);
+  }
+
+  uint32_t penalty = memory_read();
+  if (evicted.dirty) {
+    uint32_t writeback = memory_write();
+    l2cacheWritebacks++;
+    l2cacheWritebackPenalties += writeback;
+    penalty += writeback;
+  }
+
+  return penalty;
+}
+
 // Perform a memory access to the l2cache for the address 'addr'
 // Return the access time for the memory operation
 //
 uint32_t
-l2cache_access(uint32_t addr)
+l2cache_access(addr_t addr)
 {
+  if (l2cacheSets == 0) {
+    return memory_read();
+  }
+
   uint32_t addrSetBits = (addr>>numBlockBits) & l2SetMask;
   // uint32_t addrSetBits = getSetBits(addr, numBlockBits, l2cacheSets);
-  uint32_t zeroedBlockAddr = addr & blockMask;
-  CacheBlock * blocks = L2Cache->sets[addrSetBits].blocks;
+  addr_t zeroedBlockAddr = addr & blockMask;
+  CacheSet * set = L2Cache->sets + addrSetBits;
+  CacheBlock * filled;
 
-  if (l2cacheSets == 0) {
-    return memspeed;
-  }
   l2cacheRefs++;
 
-  // check if addr exists in cache
-  for (int i = 0; i < l2cacheAssoc; i++) {
-
-    CacheBlock blockToCheck = blocks[i];
-    if (blockToCheck.valid == 1 && blockToCheck.address == zeroedBlockAddr) {
-            // update LRU of blocks on hit
-            updateBlocksLRUHit(blocks, l2cacheAssoc, blockToCheck.lru);
-            
-            return l2cacheHitTime;
-          }
+  if (probeBlocks(set->blocks, l2cacheAssoc, blockTag(addr, l2TagShift))) {
+    return l2cacheHitTime;
   }
 
   // l2cache missed, check l2 cache
   l2cacheMisses++;
 
-  // bring the value into the l2 cache
-  if (L2Cache->sets[addrSetBits].numValid == l2cacheAssoc) {
-    if (inclusive) {
-      updateBlocksLRUInclusive(blocks, zeroedBlockAddr);
-    }
-    else {
-      updateBlocksLRUMiss(blocks, l2cacheAssoc, zeroedBlockAddr);
+  uint32_t penalty = l2cache_fill(set, zeroedBlockAddr, &filled);
+
+  l2cachePenalties += penalty;
+  
+  return l2cacheHitTime + penalty;
+}
+
+// Perform a store to the l2cache for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+l2cache_write(addr_t addr)
+{
+  if (l2cacheSets == 0) {
+    return memory_write();
+  }
+
+  uint32_t addrSetBits = (addr>>numBlockBits) & l2SetMask;
+  addr_t zeroedBlockAddr = addr & blockMask;
+  CacheSet * set = L2Cache->sets + addrSetBits;
+  uint32_t penalty = 0;
+
+  l2cacheRefs++;
+
+  CacheBlock * block = probeBlocks(set->blocks, l2cacheAssoc,
+                                   blockTag(addr, l2TagShift));
+  if (block == NULL) {
+    l2cacheMisses++;
+    if (!writeAllocate) {
+      // send the store straight on to memory
+      penalty = memory_write();
+      l2cachePenalties += penalty;
+      return l2cacheHitTime + penalty;
     }
+    penalty = l2cache_fill(set, zeroedBlockAddr, &block);
   }
-  else {
-    L2Cache->sets[addrSetBits].numValid++;
-    // replace the first invalid block with the new block and mark it valid
-    for (int i = 0; i < l2cacheAssoc; i++) {
-      CacheBlock * checkedBlock = blocks + i;
 
-      if (checkedBlock->valid == 0) {
-        checkedBlock->valid = 1;
-        checkedBlock->address = zeroedBlockAddr;
+  if (writeThrough) {
+    penalty += memory_write();
+  } else {
+    block->dirty = 1;
+  }
 
-        for (int j = 0; j < l2cacheAssoc; j++) {
-          blocks[j].lru++;
-        }
-        checkedBlock->lru = 0;
+  l2cachePenalties += penalty;
 
-        break;
-      }
+  return l2cacheHitTime + penalty;
+}
+
+// Write the dirty block 'addr' evicted from an L1 back to the l2cache
+// Return the access time of the writeback
+//
+uint32_t
+l2cache_writeback(addr_t addr)
+{
+  if (l2cacheSets == 0) {
+    return memory_write();
+  }
+
+  CacheBlock * blocks = L2Cache->sets[(addr>>numBlockBits) & l2SetMask].blocks;
+  addr_t tag = blockTag(addr, l2TagShift);
+
+  // a writeback is not a reference, so the LRU is left alone
+  for (int i = 0; i < l2cacheAssoc; i++) {
+    if (blocks[i].valid == 1 && blocks[i].tag == tag && !writeThrough) {
+      blocks[i].dirty = 1;
+      return l2cacheHitTime;
     }
   }
 
-  l2cachePenalties += memspeed;
-  
-  return l2cacheHitTime + memspeed;
+  // the block is no longer in the l2 cache, so it goes on to memory
+  return l2cacheHitTime + memory_write();
 }
 
 // Perform a memory access through the icache interface for the address 'addr'
 // Return the access time for the memory operation
 //
 uint32_t
-icache_access(uint32_t addr)
+icache_access(addr_t addr)
 {
-  uint32_t addrSetBits = (addr>>numBlockBits) & iSetMask;
-  // uint32_t addrSetBits = getSetBits(addr, numBlockBits, icacheSets);
-  uint32_t zeroedBlockAddr = addr & blockMask;
-  CacheBlock * blocks = ICache->sets[addrSetBits].blocks;
+  addr_t zeroedBlockAddr = addr & blockMask;
 
   if (icacheSets == 0) {
     return l2cache_access(zeroedBlockAddr);
   }
-  icacheRefs++;
 
-  // check if addr exists in cache
-  for (int i = 0; i < icacheAssoc; i++) {
+  uint32_t addrSetBits = (addr>>numBlockBits) & iSetMask;
+  // uint32_t addrSetBits = getSetBits(addr, numBlockBits, icacheSets);
+  CacheSet * set = ICache->sets + addrSetBits;
+  CacheBlock evicted;
 
-    CacheBlock blockToCheck = blocks[i];
-    if (blockToCheck.valid == 1 && blockToCheck.address == zeroedBlockAddr) {
-            // update LRU of blocks on hit
-            updateBlocksLRUHit(blocks, icacheAssoc, blockToCheck.lru);
-            
-            return icacheHitTime;
-          }
+  icacheRefs++;
+
+  addr_t tag = blockTag(addr, iTagShift);
+  if (probeBlocks(set->blocks, icacheAssoc, tag)) {
+    return icacheHitTime;
   }
 
   // icache missed, check l2 cache
@@ -364,30 +694,8 @@ icache_access(uint32_t addr)
 
   uint32_t l2Latency = l2cache_access(zeroedBlockAddr);
 
-  // bring the value into the l1 cache
-  if (ICache->sets[addrSetBits].numValid == icacheAssoc) {
-    updateBlocksLRUMiss(blocks, icacheAssoc, zeroedBlockAddr);
-  }
-  else {
-    ICache->sets[addrSetBits].numValid++;
-
-    // replace the first invalid block with the new block and mark it valid
-    for (int i = 0; i < icacheAssoc; i++) {
-      CacheBlock * checkedBlock = blocks + i;
-
-      if (checkedBlock->valid == 0) {
-        checkedBlock->valid = 1;
-        checkedBlock->address = zeroedBlockAddr;
-
-        for (int j = 0; j < icacheAssoc; j++) {
-          blocks[j].lru++;
-        }
-        checkedBlock->lru = 0;
-
-        break;
-      }
-    }
-  }
+  // bring the value into the l1 cache, instructions are never dirty
+  fillL1Block(set, icacheAssoc, tag, &evicted);
 
   icachePenalties += l2Latency;
   
@@ -398,28 +706,24 @@ icache_access(uint32_t addr)
 // Return the access time for the memory operation
 //
 uint32_t
-dcache_access(uint32_t addr)
+dcache_access(addr_t addr)
 {
-  uint32_t addrSetBits = (addr>>numBlockBits) & dSetMask;
-  // uint32_t addrSetBits = getSetBits(addr, numBlockBits, dcacheSets);
-  uint32_t zeroedBlockAddr = addr & blockMask;
-  CacheBlock * blocks = DCache->sets[addrSetBits].blocks;
+  addr_t zeroedBlockAddr = addr & blockMask;
 
   if (dcacheSets == 0) {
     return l2cache_access(zeroedBlockAddr);
   }
-  dcacheRefs++;
 
-  // check if addr exists in cache
-  for (int i = 0; i < dcacheAssoc; i++) {
+  uint32_t addrSetBits = (addr>>numBlockBits) & dSetMask;
+  // uint32_t addrSetBits = getSetBits(addr, numBlockBits, dcacheSets);
+  CacheSet * set = DCache->sets + addrSetBits;
+  CacheBlock evicted;
 
-    CacheBlock blockToCheck = blocks[i];
-    if (blockToCheck.valid == 1 && blockToCheck.address == zeroedBlockAddr) {
-            // update LRU of blocks on hit
-            updateBlocksLRUHit(blocks, dcacheAssoc, blockToCheck.lru);
-            
-            return dcacheHitTime;
-          }
+  dcacheRefs++;
+
+  addr_t tag = blockTag(addr, dTagShift);
+  if (probeBlocks(set->blocks, dcacheAssoc, tag)) {
+    return dcacheHitTime;
   }
 
   // dcache missed, check l2 cache
@@ -428,31 +732,178 @@ dcache_access(uint32_t addr)
   uint32_t l2Latency = l2cache_access(zeroedBlockAddr);
 
   // bring the value into the l1 cache
-  if (DCache->sets[addrSetBits].numValid == dcacheAssoc) {
-    updateBlocksLRUMiss(blocks, dcacheAssoc, zeroedBlockAddr);
+  fillL1Block(set, dcacheAssoc, tag, &evicted);
+  if (evicted.dirty) {
+    uint32_t writeback =
+      l2cache_writeback(tagAddress(evicted.tag, addrSetBits, dTagShift));
+    dcacheWritebacks++;
+    dcacheWritebackPenalties += writeback;
+    l2Latency += writeback;
   }
-  else {
-    DCache->sets[addrSetBits].numValid++;
-    // replace the first invalid block with the new block and mark it valid
-    for (int i = 0; i < dcacheAssoc; i++) {
-      CacheBlock * checkedBlock = blocks + i;
 
-      if (checkedBlock->valid == 0) {
-        checkedBlock->valid = 1;
+  dcachePenalties += l2Latency;
+  
+  return dcacheHitTime + l2Latency;
+}
+
+// Perform a store through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+dcache_write(addr_t addr)
+{
+  addr_t zeroedBlockAddr = addr & blockMask;
+
+  dcacheStores++;
 
-        checkedBlock->address = zeroedBlockAddr;
+  if (dcacheSets == 0) {
+    return l2cache_write(zeroedBlockAddr);
+  }
 
-        for (int j = 0; j < dcacheAssoc; j++) {
-          blocks[j].lru++;
-        }
-        checkedBlock->lru = 0;
+  uint32_t addrSetBits = (addr>>numBlockBits) & dSetMask;
+  CacheSet * set = DCache->sets + addrSetBits;
+  CacheBlock evicted;
+  uint32_t l2Latency = 0;
+
+  dcacheRefs++;
 
-        break;
+  addr_t tag = blockTag(addr, dTagShift);
+  CacheBlock * block = probeBlocks(set->blocks, dcacheAssoc, tag);
+  if (block == NULL) {
+    dcacheMisses++;
+
+    if (writeAllocate) {
+      l2Latency = l2cache_access(zeroedBlockAddr);
+      block = fillL1Block(set, dcacheAssoc, tag, &evicted);
+      if (evicted.dirty) {
+        uint32_t writeback =
+          l2cache_writeback(tagAddress(evicted.tag, addrSetBits, dTagShift));
+        dcacheWritebacks++;
+        dcacheWritebackPenalties += writeback;
+        l2Latency += writeback;
       }
     }
   }
+
+  if (block == NULL || writeThrough) {
+    // the store goes on to the l2 cache
+    l2Latency += l2cache_write(zeroedBlockAddr);
+  } else {
+    block->dirty = 1;
+  }
+
   dcachePenalties += l2Latency;
-  
+
   return dcacheHitTime + l2Latency;
 }
 
+// Perform the L1 part of 'n' accesses of 'core' without touching the L2
+// or the selected core.  Sets actions[i] to the L1_* work access i leaves
+// for the L2, and victims[i] to the block to write back.
+// Only valid while the L2 is not inclusive, since then nothing the L2
+// does can change the contents of an L1.
+//
+void
+l1cache_access_batch(uint32_t core, const addr_t *addrs, const char *i_or_d,
+                     uint32_t n, uint8_t *actions, addr_t *victims)
+{
+  CoreStats * stats = coreStats + core;
+  Cache * icache = ICaches[core];
+  Cache * dcache = DCaches[core];
+  CacheBlock evicted;
+
+  for (uint32_t i = 0; i < n; i++) {
+    CacheBlock * block;
+
+    if (i_or_d[i] == 'I') {
+      if (icacheSets == 0) {
+        actions[i] = L1_MISS;
+        continue;
+      }
+      CacheSet * set = icache->sets + ((addrs[i]>>numBlockBits) & iSetMask);
+      addr_t tag = blockTag(addrs[i], iTagShift);
+      stats->icacheRefs++;
+      actions[i] = 0;
+      if (!probeBlocks(set->blocks, icacheAssoc, tag)) {
+        stats->icacheMisses++;
+        fillL1Block(set, icacheAssoc, tag, &evicted);
+        actions[i] = L1_MISS;
+      }
+      continue;
+    }
+
+    uint32_t store = i_or_d[i] == 'W';
+    if (store) {
+      stats->dcacheStores++;
+    }
+    if (dcacheSets == 0) {
+      actions[i] = store ? L1_WRITE : L1_MISS;
+      continue;
+    }
+
+    uint32_t addrSetBits = (addrs[i]>>numBlockBits) & dSetMask;
+    CacheSet * set = dcache->sets + addrSetBits;
+    addr_t tag = blockTag(addrs[i], dTagShift);
+    stats->dcacheRefs++;
+    actions[i] = 0;
+    block = probeBlocks(set->blocks, dcacheAssoc, tag);
+    if (block == NULL) {
+      stats->dcacheMisses++;
+      if (!store || writeAllocate) {
+        block = fillL1Block(set, dcacheAssoc, tag, &evicted);
+        actions[i] = L1_MISS;
+        if (evicted.dirty) {
+          actions[i] |= L1_WRITEBACK;
+          victims[i] = tagAddress(evicted.tag, addrSetBits, dTagShift);
+        }
+      }
+    }
+    if (store) {
+      if (block == NULL || writeThrough) {
+        actions[i] |= L1_WRITE;
+      } else {
+        block->dirty = 1;
+      }
+    }
+  }
+}
+
+// Finish an access of 'core' that l1cache_access_batch left work for the
+// L2 for, doing that work in the order the single-core path does it
+// Return the access time for the memory operation
+//
+uint32_t
+l1cache_complete(uint32_t core, addr_t addr, char i_or_d, uint8_t action,
+                 addr_t victim)
+{
+  CoreStats * stats = coreStats + core;
+  addr_t zeroedBlockAddr = addr & blockMask;
+  uint32_t l2Latency = 0;
+
+  if (action & L1_MISS) {
+    l2Latency += l2cache_access(zeroedBlockAddr);
+  }
+  if (action & L1_WRITEBACK) {
+    uint32_t writeback = l2cache_writeback(victim);
+    stats->dcacheWritebacks++;
+    stats->dcacheWritebackPenalties += writeback;
+    l2Latency += writeback;
+  }
+  if (action & L1_WRITE) {
+    l2Latency += l2cache_write(zeroedBlockAddr);
+  }
+
+  if (i_or_d == 'I') {
+    if (icacheSets == 0) {
+      return l2Latency;
+    }
+    stats->icachePenalties += l2Latency;
+    return icacheHitTime + l2Latency;
+  }
+
+  if (dcacheSets == 0) {
+    return l2Latency;
+  }
+  stats->dcachePenalties += l2Latency;
+  return dcacheHitTime + l2Latency;
+}
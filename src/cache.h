@@ -26,6 +26,29 @@ extern const char *email;
 #define TRUE 1
 #define FALSE 0
 
+// Bump whenever a change alters the simulated statistics, so that
+// results saved by an older simulator are not reused
+#define SIM_VERSION 4
+
+// Work an access leaves for the L2 after l1cache_access_batch
+#define L1_MISS      1  // Fetch the block from the L2
+#define L1_WRITEBACK 2  // Write the dirty victim back to the L2
+#define L1_WRITE     4  // Send the store on to the L2
+
+// Addresses are 32 bits wide unless built with -DADDR64 (make cache64).
+// The 64-bit build keeps only the low bits of the tag of each block, so
+// blocks stay the same size, and rejects addresses above maxTraceAddr
+// whose tags would not fit.
+#ifdef ADDR64
+typedef uint64_t addr_t;
+#define TRACE_ADDR(addr) \
+  ((addr) > maxTraceAddr ? wide_addr_error(addr) : (addr))
+#else
+typedef uint32_t addr_t;
+#define TRACE_ADDR(addr) \
+  ((addr) > UINT32_MAX ? wide_addr_error(addr) : (uint32_t)(addr))
+#endif
+
 //------------------------------------//
 //        Cache Configuration         //
 //------------------------------------//
@@ -42,9 +65,12 @@ extern uint32_t l2cacheSets;    // Number of sets in the L2$
 extern uint32_t l2cacheAssoc;   // Associativity of the L2$
 extern uint32_t l2cacheHitTime; // Hit Time of the L2$
 extern uint32_t inclusive;      // Indicates if the L2 is inclusive
+extern uint32_t writeThrough;   // Indicates if stores write through to the next level
+extern uint32_t writeAllocate;  // Indicates if store misses allocate a block
 
 extern uint32_t blocksize;      // Block/Line size
 extern uint32_t memspeed;       // Latency of Main Memory
+extern uint32_t numCores;       // Number of cores with private I$ and D$
 
 //------------------------------------//
 //          Cache Statistics          //
@@ -57,10 +83,37 @@ extern uint64_t icachePenalties;  // I$ penalties
 extern uint64_t dcacheRefs;       // D$ references
 extern uint64_t dcacheMisses;     // D$ misses
 extern uint64_t dcachePenalties;  // D$ penalties
+extern uint64_t dcacheStores;     // D$ stores
+extern uint64_t dcacheWritebacks; // D$ dirty blocks written back
+extern uint64_t dcacheWritebackPenalties; // D$ penalties of writebacks
 
 extern uint64_t l2cacheRefs;      // L2$ references
 extern uint64_t l2cacheMisses;    // L2$ misses
 extern uint64_t l2cachePenalties; // L2$ penalties
+extern uint64_t l2cacheWritebacks; // L2$ dirty blocks written back
+extern uint64_t l2cacheWritebackPenalties; // L2$ penalties of writebacks
+
+extern uint64_t memReads;         // Blocks read from main memory
+extern uint64_t memWrites;        // Blocks written to main memory
+
+// I$ and D$ statistics of one core
+typedef struct CoreStats {
+  uint64_t icacheRefs;
+  uint64_t icacheMisses;
+  uint64_t icachePenalties;
+  uint64_t dcacheRefs;
+  uint64_t dcacheMisses;
+  uint64_t dcachePenalties;
+  uint64_t dcacheStores;
+  uint64_t dcacheWritebacks;
+  uint64_t dcacheWritebackPenalties;
+} CoreStats;
+
+extern CoreStats *coreStats;      // Per-core I$ and D$ statistics
+
+#ifdef ADDR64
+extern uint64_t maxTraceAddr;     // Widest address whose tags all fit
+#endif
 
 //------------------------------------//
 //      Cache Function Prototypes     //
@@ -70,19 +123,66 @@ extern uint64_t l2cachePenalties; // L2$ penalties
 //
 void init_cache();
 
+// Report a trace address too wide for this build and exit.  Used by
+// TRACE_ADDR, which turns the 64-bit address parsed from a trace line
+// into an addr_t.
+//
+addr_t wide_addr_error(uint64_t addr);
+
 // Perform a memory access through the icache interface for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t icache_access(uint32_t addr);
+uint32_t icache_access(addr_t addr);
 
 // Perform a memory access through the dcache interface for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t dcache_access(uint32_t addr);
+uint32_t dcache_access(addr_t addr);
+
+// Perform a store through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t dcache_write(addr_t addr);
 
 // Perform a memory access to the l2cache for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t l2cache_access(uint32_t addr);
+uint32_t l2cache_access(addr_t addr);
+
+// Perform a store to the l2cache for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t l2cache_write(addr_t addr);
+
+// Write the dirty block 'addr' evicted from an L1 back to the l2cache
+// Return the access time of the writeback
+//
+uint32_t l2cache_writeback(addr_t addr);
+
+// Make 'core' the core whose I$ and D$ serve icache_access and
+// dcache_access.  The I$/D$ counters of the previously selected core are
+// saved to coreStats and those of 'core' are loaded in their place.
+//
+void select_core(uint32_t core);
+
+// Load the sum of the per-core statistics into the I$/D$ counters
+//
+void collect_core_stats();
+
+// Perform the L1 part of 'n' accesses of 'core' without touching the L2.
+// Sets actions[i] to the L1_* work access i leaves for the L2, and
+// victims[i] to the block to write back.  Only valid while the L2 is not
+// inclusive.  Calls for different cores may run concurrently.
+//
+void l1cache_access_batch(uint32_t core, const addr_t *addrs,
+                          const char *i_or_d, uint32_t n, uint8_t *actions,
+                          addr_t *victims);
+
+// Finish an access of 'core' that l1cache_access_batch left work for the
+// L2 for
+// Return the access time for the memory operation
+//
+uint32_t l1cache_complete(uint32_t core, addr_t addr, char i_or_d,
+                          uint8_t action, addr_t victim);
 
 #endif
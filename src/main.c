@@ -5,12 +5,19 @@
 //========================================================//
 
 #define _GNU_SOURCE
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "cache.h"
+#include "store.h"
+#include "multicore.h"
+#include "timing.h"
+#include "profile.h"
+#include "simpoint.h"
 
 FILE *stream;
+FILE **streams;     // The trace of each core
 char *buf = NULL;
 size_t len = 0;
 
@@ -19,7 +26,7 @@ size_t len = 0;
 void
 usage()
 {
-  fprintf(stderr,"Usage: cache <options> [<trace>]\n");
+  fprintf(stderr,"Usage: cache <options> [<trace> ...]\n");
   fprintf(stderr,"       bunzip -kc trace.bz2 | cache <options>\n");
   fprintf(stderr," Options:\n");
   fprintf(stderr," --help                     Print this message\n");
@@ -29,6 +36,26 @@ usage()
   fprintf(stderr," --inclusive                Makes L2-cache be inclusive\n");
   fprintf(stderr," --blocksize=size           Block/Line size\n");
   fprintf(stderr," --memspeed=latency         Latency to Main Memory\n");
+  fprintf(stderr," --writethrough             Write stores through instead of back\n");
+  fprintf(stderr," --no-write-allocate        Store misses do not allocate a block\n");
+  fprintf(stderr," --profile                  Report the time of each phase\n");
+  fprintf(stderr," --timing                   Use the non-blocking timing model\n");
+  fprintf(stderr," --mshrs=l1:l2              MSHRs of each L1 and of the L2\n");
+  fprintf(stderr," --membw=cycles             Memory bus cycles per block\n");
+  fprintf(stderr," --memqueue=depth           Outstanding memory requests\n");
+  fprintf(stderr," --simpoint-analyze=file    Write weighted simulation points\n");
+  fprintf(stderr," --simpoint-replay=file     Simulate only the simulation points\n");
+  fprintf(stderr," --interval=refs            References per SimPoint interval\n");
+  fprintf(stderr," --simpoints=k              Simulation points to pick\n");
+  fprintf(stderr," --warmup=refs              Warmup before each simulation point\n");
+  fprintf(stderr," --interleave=rr|time       Interleave the traces of the cores\n");
+  fprintf(stderr,"                            round-robin or by timestamp\n");
+  fprintf(stderr," --threads=n                Threads simulating the per-core L1s\n");
+  fprintf(stderr," --store=dir                Directory of stored results\n");
+  fprintf(stderr," --no-store                 Bypass the stored results\n");
+  fprintf(stderr," --refresh-store            Resimulate and overwrite stored results\n");
+  fprintf(stderr," --store-digest             Read a trace file the store has not\n");
+  fprintf(stderr,"                            seen by name to find its results\n");
 }
 
 // Process an option and update the cache
@@ -51,6 +78,44 @@ handle_option(char *arg)
     sscanf(arg+12,"%u", &blocksize);
   } else if (!strncmp(arg,"--memspeed=",11)) {
     sscanf(arg+11,"%u", &memspeed);
+  } else if (!strcmp(arg,"--writethrough")) {
+    writeThrough = TRUE;
+  } else if (!strcmp(arg,"--no-write-allocate")) {
+    writeAllocate = FALSE;
+  } else if (!strcmp(arg,"--profile")) {
+    profile = TRUE;
+  } else if (!strcmp(arg,"--timing")) {
+    timingModel = TRUE;
+  } else if (!strncmp(arg,"--mshrs=",8)) {
+    sscanf(arg+8,"%u:%u", &l1MSHRs, &l2MSHRs);
+  } else if (!strncmp(arg,"--membw=",8)) {
+    sscanf(arg+8,"%u", &membw);
+  } else if (!strncmp(arg,"--memqueue=",11)) {
+    sscanf(arg+11,"%u", &memqueue);
+  } else if (!strncmp(arg,"--simpoint-analyze=",19)) {
+    simpointAnalyze = arg+19;
+  } else if (!strncmp(arg,"--simpoint-replay=",18)) {
+    simpointReplay = arg+18;
+  } else if (!strncmp(arg,"--interval=",11)) {
+    sscanf(arg+11,"%u", &simpointInterval);
+  } else if (!strncmp(arg,"--simpoints=",12)) {
+    sscanf(arg+12,"%u", &simpointMaxK);
+  } else if (!strncmp(arg,"--warmup=",9)) {
+    sscanf(arg+9,"%u", &simpointWarmup);
+  } else if (!strcmp(arg,"--interleave=rr")) {
+    interleave = INTERLEAVE_RR;
+  } else if (!strcmp(arg,"--interleave=time")) {
+    interleave = INTERLEAVE_TIME;
+  } else if (!strncmp(arg,"--threads=",10)) {
+    sscanf(arg+10,"%u", &numThreads);
+  } else if (!strncmp(arg,"--store=",8)) {
+    storeDir = arg+8;
+  } else if (!strcmp(arg,"--no-store")) {
+    storeMode = STORE_BYPASS;
+  } else if (!strcmp(arg,"--refresh-store")) {
+    storeMode = STORE_REFRESH;
+  } else if (!strcmp(arg,"--store-digest")) {
+    storeDigest = TRUE;
   } else {
     return 0;
   }
@@ -97,8 +162,64 @@ printCacheConfig()
     printf("    Lat:   %u Cycles\n", l2cacheHitTime);
     printf("    Inclusive: %s\n", inclusive ? "Yes" : "No");
   }
+  if (numCores > 1) {
+    printf("  Cores:      %u\n", numCores);
+  }
   printf("  Block Size: %u Bytes\n", blocksize);
   printf("  Memspeed:   %u Cycles\n", memspeed);
+  if (timingModel) {
+    printf("  Timing Model:\n");
+    printf("    L1 MSHRs:     %u\n", l1MSHRs);
+    printf("    L2 MSHRs:     %u\n", l2MSHRs);
+    printf("    Memory Bus:   %u Cycles/Block\n", membw);
+    printf("    Memory Queue: %u\n", memqueue);
+  }
+}
+
+// Print out the Statistics of the I$ or D$ named 'cache'
+//
+void
+printL1Stats(char cache, uint64_t refs, uint64_t misses, uint64_t penalties,
+             uint32_t hitTime)
+{
+  printf("  total %c-cache accesses:  %10lu\n", cache, refs);
+  printf("  total %c-cache misses:    %10lu\n", cache, misses);
+  printf("  total %c-cache penalties: %10lu\n", cache, penalties);
+  if (refs > 0) {
+    printf("  %c-cache miss rate:   %17.2f%%\n", cache,
+        100.0*(double)misses/(double)refs);
+    printf("  avg %c-cache access time: %13.2f cycles\n", cache,
+        (double)((penalties + refs * hitTime))/refs);
+  } else {
+    printf("  %c-cache miss rate:                -\n", cache);
+    printf("  avg %c-cache access time:          -\n", cache);
+  }
+}
+
+// Print out the I$ and D$ Statistics of each core
+//
+void
+printCoreStats()
+{
+  for (int i = 0; i < numCores; i++) {
+    printf("Core %d Statistics:\n", i);
+    if (icacheSets) {
+      printL1Stats('I', coreStats[i].icacheRefs, coreStats[i].icacheMisses,
+                   coreStats[i].icachePenalties, icacheHitTime);
+    }
+    if (dcacheSets) {
+      printL1Stats('D', coreStats[i].dcacheRefs, coreStats[i].dcacheMisses,
+                   coreStats[i].dcachePenalties, dcacheHitTime);
+    }
+    printf("  Memory accesses:  %lu\n", coreRefs[i]);
+    printf("  Memory penalties: %lu\n", corePenalties[i]);
+    if (coreRefs[i] > 0) {
+      printf("  avg Memory access time: %11.2f cycles\n",
+          (double)corePenalties[i] / coreRefs[i]);
+    } else {
+      printf("  avg Memory access time:           -\n");
+    }
+  }
 }
 
 // Print out the Cache Statistics
@@ -108,32 +229,10 @@ printCacheStats()
 {
   printf("Cache Statistics:\n");
   if (icacheSets) {
-    printf("  total I-cache accesses:  %10lu\n", icacheRefs);
-    printf("  total I-cache misses:    %10lu\n", icacheMisses);
-    printf("  total I-cache penalties: %10lu\n", icachePenalties);
-    if (icacheRefs > 0) {
-      printf("  I-cache miss rate:   %17.2f%%\n",
-          100.0*(double)icacheMisses/(double)icacheRefs);
-      printf("  avg I-cache access time: %13.2f cycles\n",
-          (double)((icachePenalties + icacheRefs * icacheHitTime))/icacheRefs);
-    } else {
-      printf("  I-cache miss rate:                -\n");
-      printf("  avg I-cache access time:          -\n");
-    }
+    printL1Stats('I', icacheRefs, icacheMisses, icachePenalties, icacheHitTime);
   }
   if (dcacheSets) {
-    printf("  total D-cache accesses:  %10lu\n", dcacheRefs);
-    printf("  total D-cache misses:    %10lu\n", dcacheMisses);
-    printf("  total D-cache penalties: %10lu\n", dcachePenalties);
-    if (dcacheRefs > 0) {
-      printf("  D-cache miss rate:   %17.2f%%\n",
-          100.0*(double)dcacheMisses/(double)dcacheRefs);
-      printf("  avg D-cache access time: %13.2f cycles\n",
-          (double)((dcachePenalties + dcacheRefs * dcacheHitTime))/dcacheRefs);
-    } else {
-      printf("  D-cache miss rate:                -\n");
-      printf("  avg D-cache access time:          -\n");
-    }
+    printL1Stats('D', dcacheRefs, dcacheMisses, dcachePenalties, dcacheHitTime);
   }
   if (l2cacheSets) {
     printf("  total L2-cache accesses: %10lu\n", l2cacheRefs);
@@ -152,6 +251,68 @@ printCacheStats()
   }
 }
 
+// Print out the Statistics of the stores and the traffic they cause
+//
+void
+printWriteStats()
+{
+  printf("Write Statistics:\n");
+  printf("  policy: %s, %s\n", writeThrough ? "write-through" : "write-back",
+      writeAllocate ? "write-allocate" : "no-write-allocate");
+  printf("  total stores:            %10lu\n", dcacheStores);
+  if (dcacheSets) {
+    printf("  D-cache writebacks:      %10lu\n", dcacheWritebacks);
+    printf("  D-cache writeback cycles:%10lu\n", dcacheWritebackPenalties);
+  }
+  if (l2cacheSets) {
+    printf("  L2-cache writebacks:     %10lu\n", l2cacheWritebacks);
+    printf("  L2-cache writeback cycles:%9lu\n", l2cacheWritebackPenalties);
+  }
+  printf("  memory block reads:      %10lu (%lu bytes)\n", memReads,
+      memReads * blocksize);
+  printf("  memory block writes:     %10lu (%lu bytes)\n", memWrites,
+      memWrites * blocksize);
+}
+
+// Print out the Statistics of the timing model
+//
+void
+printTimingStats(uint64_t totalRefs)
+{
+  printf("Timing Statistics:\n");
+  printf("  execution cycles:        %10lu\n", timingCycles);
+  printf("  total access latency:    %10lu\n", timingLatency);
+  printf("  overlapped latency:      %10lu\n", overlappedLatency);
+  if (totalRefs > 0) {
+    printf("  avg access latency:      %13.2f cycles\n",
+        (double)timingLatency / totalRefs);
+  }
+  printf("  MSHR merges:             %10lu\n", mshrMerges);
+  if (icacheSets) {
+    printf("  I-cache MSHR-full stalls:%10lu\n", icacheMSHRStalls);
+  }
+  if (dcacheSets) {
+    printf("  D-cache MSHR-full stalls:%10lu\n", dcacheMSHRStalls);
+  }
+  if (l2cacheSets) {
+    printf("  L2-cache MSHR-full stalls:%9lu\n", l2cacheMSHRStalls);
+  }
+  printf("  memory requests:         %10lu\n", memRequests);
+  printf("  memory bus wait:         %10lu\n", memQueueDelay);
+  printf("  memory queue-full stalls:%10lu\n", memQueueFullStalls);
+  printf("  max memory queue occupancy:%8lu\n", memQueueMax);
+  if (memRequests > 0) {
+    printf("  avg memory queue occupancy:%8.2f\n",
+        (double)memQueueOccupancy / memRequests);
+  } else {
+    printf("  avg memory queue occupancy:       -\n");
+  }
+  if (timingCycles > 0) {
+    printf("  accesses per cycle:      %13.2f\n",
+        (double)totalRefs / timingCycles);
+  }
+}
+
 // Set the defaults for the Cache Simulator
 //
 void
@@ -171,8 +332,11 @@ set_defaults()
   l2cacheAssoc    = 0;
   l2cacheHitTime  = 0;
   inclusive       = 0;
+  writeThrough    = 0;
+  writeAllocate   = 1;
   blocksize       = 16;
   memspeed        = 50;
+  numCores        = 1;
 }
 
 // Reads a line from the input stream and extracts the
@@ -181,20 +345,128 @@ set_defaults()
 // Returns True if Successful 
 //
 int
-read_mem_access(uint32_t *addr, char *i_or_d)
+read_mem_access(addr_t *addr, char *i_or_d)
 {
-  if (getline(&buf, &len, stream) == -1) {
+  uint64_t wideAddr = 0;
+  ssize_t n = getline(&buf, &len, stream);
+  if (n == -1) {
     return 0;
   }
 
-  sscanf(buf,"0x%x %c\n",addr,i_or_d);
+  if (storeMode != STORE_BYPASS) {
+    digest_update(buf, n);
+  }
+
+  sscanf(buf,"0x%" SCNx64 " %c\n",&wideAddr,i_or_d);
+  *addr = TRACE_ADDR(wideAddr);
 
   return 1;
 }
 
+// Direct the memory access to the appropriate cache.  'D' and 'R' are
+// loads and 'W' is a store.
+//
+// Returns the access time for the memory operation
+//
+static inline uint32_t
+simulate_access(addr_t addr, char i_or_d)
+{
+  if (i_or_d != 'I' && i_or_d != 'D' && i_or_d != 'R' && i_or_d != 'W') {
+    fprintf(stderr,"Input Error '%c' must be one of 'I', 'D', 'R' or 'W'\n",
+        i_or_d);
+    exit(1);
+  } else if (timingModel) {
+    return timed_access(addr, i_or_d);
+  } else if (i_or_d == 'I') {
+    return icache_access(addr);
+  } else if (i_or_d == 'W') {
+    return dcache_write(addr);
+  } else {
+    return dcache_access(addr);
+  }
+}
+
+// Simulate the trace a batch of bytes at a time, timing the reading,
+// parsing and simulation of each batch as separate phases
+//
+void
+simulate_profiled(uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  char *batch = (char *) malloc(PROFILE_BATCH_BYTES + 1);
+  addr_t *addrs = (addr_t *) malloc(PROFILE_BATCH_BYTES * sizeof(addr_t));
+  char *types = (char *) malloc(PROFILE_BATCH_BYTES);
+  size_t carried = 0;  // Bytes of a partial line kept from the last batch
+  uint64_t addr = 0;
+  char i_or_d = '\0';
+
+  while (TRUE) {
+    profile_start(PHASE_READ);
+    size_t n = carried +
+        fread(batch + carried, 1, PROFILE_BATCH_BYTES - carried, stream);
+    int eof = feof(stream) || ferror(stream);
+    profile_stop(PHASE_READ);
+    if (n == 0) {
+      break;
+    }
+    if (n == PROFILE_BATCH_BYTES && carried == PROFILE_BATCH_BYTES) {
+      fprintf(stderr,"Input Error line longer than %d bytes\n",
+          PROFILE_BATCH_BYTES);
+      exit(1);
+    }
+
+    // Parse the whole lines of the batch like read_mem_access
+    profile_start(PHASE_PARSE);
+    uint32_t numAccesses = 0;
+    char *line = batch;
+    char *end = batch + n;
+    while (line < end) {
+      char *newline = memchr(line, '\n', end - line);
+      if (newline == NULL && !eof) {
+        break;
+      }
+      char *next = newline ? newline + 1 : end;
+
+      if (storeMode != STORE_BYPASS) {
+        digest_update(line, next - line);
+      }
+
+      // Keep sscanf from running into the next line
+      char saved = *next;
+      *next = '\0';
+      sscanf(line,"0x%" SCNx64 " %c\n",&addr,&i_or_d);
+      *next = saved;
+
+      addrs[numAccesses] = TRACE_ADDR(addr);
+      types[numAccesses] = i_or_d;
+      numAccesses++;
+      line = next;
+    }
+    carried = end - line;
+    memmove(batch, line, carried);
+    profile_stop(PHASE_PARSE);
+
+    profile_start(PHASE_SIMULATE);
+    for (uint32_t i = 0; i < numAccesses; i++) {
+      *totalPenalties += simulate_access(addrs[i], types[i]);
+    }
+    *totalRefs += numAccesses;
+    profile_stop(PHASE_SIMULATE);
+
+    if (eof && carried == 0) {
+      break;
+    }
+  }
+
+  free(batch);
+  free(addrs);
+  free(types);
+}
+
 int
 main(int argc, char *argv[])
 {
+  uint32_t numTraces = 0;
+
   // Set defaults
   set_defaults();
 
@@ -210,36 +482,112 @@ main(int argc, char *argv[])
         exit(1);
       }
     } else {
-      // Use as input file
-      stream = fopen(argv[i], "r");
+      // Use as input file, one per core
+      streams = (FILE **) realloc(streams, (numTraces + 1) * sizeof(FILE *));
+      streams[numTraces++] = fopen(argv[i], "r");
     }
   }
 
-  // Initialize the cache
-  init_cache();
+  if (numTraces > 0) {
+    stream = streams[0];
+  }
+  if (numTraces > 1) {
+    numCores = numTraces;
+    // The store is keyed by a single trace
+    storeMode = STORE_BYPASS;
+  }
+  if (numCores > 1 && timingModel) {
+    fprintf(stderr,"The timing model only supports a single trace\n");
+    exit(1);
+  }
+  if ((simpointAnalyze || simpointReplay) && (numCores > 1 || timingModel)) {
+    fprintf(stderr,"SimPoint runs only support a single trace and the flat model\n");
+    exit(1);
+  }
+  if (simpointInterval == 0) {
+    simpointInterval = 1;
+  }
+
+  // Only pick the simulation points
+  if (simpointAnalyze) {
+    simpoint_analyze(stream);
+    fclose(stream);
+    free(streams);
+    return 0;
+  }
+
+  if (profile) {
+    init_profile();
+  }
 
   uint64_t totalRefs = 0;
   uint64_t totalPenalties = 0;
-  uint32_t addr = 0;
+  addr_t addr = 0;
   char i_or_d = '\0';
 
-  // Read each memory access from the trace
-  while (read_mem_access(&addr, &i_or_d)) {
-    totalRefs++;
-    // Direct the memory access to the appropriate cache
-    if (i_or_d == 'I') {
-      totalPenalties += icache_access(addr);
-    } else if (i_or_d == 'D') {
-      totalPenalties += dcache_access(addr);
+  // Reuse the results of an earlier run of this trace and configuration
+  int stored = FALSE;
+  if (storeMode == STORE_USE && simpointReplay == NULL) {
+    stored = store_lookup(stream, &totalRefs, &totalPenalties);
+  }
+
+  if (numCores > 1) {
+    init_cache();
+    // The traces are read and parsed as part of the simulation
+    if (profile) {
+      profile_start(PHASE_SIMULATE);
+    }
+    simulate_multicore(streams, &totalRefs, &totalPenalties);
+    if (profile) {
+      profile_stop(PHASE_SIMULATE);
+    }
+  } else if (simpointReplay) {
+    init_cache();
+    // The trace is read and parsed as part of the replay
+    if (profile) {
+      profile_start(PHASE_SIMULATE);
+    }
+    simpoint_replay(stream, &totalRefs, &totalPenalties);
+    if (profile) {
+      profile_stop(PHASE_SIMULATE);
+    }
+  } else if (!stored) {
+    // Initialize the cache
+    init_cache();
+    if (timingModel) {
+      init_timing();
+    }
+    digest_init();
+
+    if (profile) {
+      simulate_profiled(&totalRefs, &totalPenalties);
     } else {
-      fprintf(stderr,"Input Error '%c' must be either 'I' or 'D'\n", i_or_d);
-      exit(1);
+      // Read each memory access from the trace
+      while (read_mem_access(&addr, &i_or_d)) {
+        totalRefs++;
+        totalPenalties += simulate_access(addr, i_or_d);
+      }
+    }
+
+    if (timingModel) {
+      finish_timing();
+    }
+
+    if (storeMode != STORE_BYPASS) {
+      store_save(stream, totalRefs, totalPenalties);
     }
   }
 
   // Print out the statistics
+  if (profile) {
+    profile_start(PHASE_REPORT);
+  }
   printStudentInfo();
   printCacheConfig();
+  if (numCores > 1) {
+    printCoreStats();
+    collect_core_stats();
+  }
   printCacheStats();
   printf("Total Memory accesses:  %lu\n", totalRefs);
   printf("Total Memory penalties: %lu\n", totalPenalties);
@@ -249,9 +597,27 @@ main(int argc, char *argv[])
   } else {
     printf("avg Memory access time:             -\n");
   }
+  if (dcacheStores > 0) {
+    printWriteStats();
+  }
+  if (timingModel) {
+    printTimingStats(totalRefs);
+  }
+  if (simpointReplay) {
+    simpoint_print_error(stream, totalRefs, totalPenalties);
+  }
+  if (profile) {
+    fflush(stdout);
+    profile_stop(PHASE_REPORT);
+    print_profile(totalRefs);
+  }
 
   // Cleanup
   fclose(stream);
+  for (int i = 1; i < numTraces; i++) {
+    fclose(streams[i]);
+  }
+  free(streams);
   free(buf);
 
   return 0;
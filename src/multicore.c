@@ -0,0 +1,324 @@
+//========================================================//
+//  multicore.c                                           //
+//  Source file for the multi-core trace driver           //
+//                                                        //
+//  With an inclusive L2 every L2 eviction can invalidate //
+//  lines of any core, so the accesses are simulated one  //
+//  at a time in the interleaved order.  Otherwise the    //
+//  L1s never depend on the L2, so a batch of accesses is //
+//  run through the per-core L1s on separate threads and  //
+//  only the misses go through the shared L2 in order.    //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "cache.h"
+#include "multicore.h"
+
+//------------------------------------//
+//      Multi-core Configuration      //
+//------------------------------------//
+
+uint32_t interleave = INTERLEAVE_RR;
+uint32_t numThreads = 0;
+
+//------------------------------------//
+//        Multi-core Statistics       //
+//------------------------------------//
+
+uint64_t *coreRefs;
+uint64_t *corePenalties;
+
+//------------------------------------//
+//     Multi-core Data Structures     //
+//------------------------------------//
+
+#define BATCH_SIZE (1 << 20)  // Accesses interleaved per parallel step
+
+// The trace of one core and its next access
+typedef struct CoreTrace {
+  FILE *stream;
+  char *buf;
+  size_t len;
+
+  uint8_t pending;     // True while the access below is not yet simulated
+  addr_t addr;
+  char i_or_d;
+  uint64_t timestamp;
+} CoreTrace;
+
+CoreTrace *coreTraces;
+uint32_t rrNextCore;
+
+// The accesses of one batch split by core, in trace order
+typedef struct CoreBatch {
+  uint32_t n;
+  addr_t *addrs;
+  char *i_or_d;
+  uint8_t *actions;
+  addr_t *victims;
+} CoreBatch;
+
+// A batch of interleaved accesses
+typedef struct Batch {
+  uint32_t n;
+  uint32_t *cores;        // Core of each access in interleaved order
+  CoreBatch *coreBatches;
+} Batch;
+
+//------------------------------------//
+//       Multi-core Functions         //
+//------------------------------------//
+
+// Read the next access of a core into its CoreTrace
+static void
+read_core_access(CoreTrace *trace)
+{
+  if (getline(&trace->buf, &trace->len, trace->stream) == -1) {
+    trace->pending = FALSE;
+    return;
+  }
+
+  uint64_t wideAddr = 0;
+  int fields = sscanf(trace->buf, "0x%" SCNx64 " %c %" SCNu64 "\n",
+                      &wideAddr, &trace->i_or_d, &trace->timestamp);
+  trace->addr = TRACE_ADDR(wideAddr);
+  if (interleave == INTERLEAVE_TIME && fields < 3) {
+    fprintf(stderr,"Input Error missing timestamp in '%s'\n", trace->buf);
+    exit(1);
+  }
+  if (trace->i_or_d != 'I' && trace->i_or_d != 'D' &&
+      trace->i_or_d != 'R' && trace->i_or_d != 'W') {
+    fprintf(stderr,"Input Error '%c' must be one of 'I', 'D', 'R' or 'W'\n",
+        trace->i_or_d);
+    exit(1);
+  }
+  trace->pending = TRUE;
+}
+
+// Returns the core whose access comes next, or -1 once all traces ended
+static int
+next_core()
+{
+  int next = -1;
+
+  if (interleave == INTERLEAVE_RR) {
+    for (uint32_t i = 0; i < numCores; i++) {
+      uint32_t core = (rrNextCore + i) % numCores;
+      if (coreTraces[core].pending) {
+        rrNextCore = core + 1;
+        return core;
+      }
+    }
+    return -1;
+  }
+
+  // Earliest timestamp first, ties going to the lowest core
+  for (uint32_t core = 0; core < numCores; core++) {
+    if (coreTraces[core].pending &&
+        (next < 0 || coreTraces[core].timestamp < coreTraces[next].timestamp)) {
+      next = core;
+    }
+  }
+  return next;
+}
+
+// Simulate the interleaved accesses one at a time
+static void
+simulate_serial(uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  uint32_t selected = 0;
+  int core;
+
+  while ((core = next_core()) >= 0) {
+    CoreTrace *trace = coreTraces + core;
+    uint32_t penalty;
+
+    if (core != selected) {
+      select_core(core);
+      selected = core;
+    }
+    if (trace->i_or_d == 'I') {
+      penalty = icache_access(trace->addr);
+    } else if (trace->i_or_d == 'W') {
+      penalty = dcache_write(trace->addr);
+    } else {
+      penalty = dcache_access(trace->addr);
+    }
+    coreRefs[core]++;
+    corePenalties[core] += penalty;
+    *totalRefs += 1;
+    *totalPenalties += penalty;
+
+    read_core_access(trace);
+  }
+
+  // Save the statistics of the last selected core
+  select_core(0);
+}
+
+// Runs the L1s of the cores first, first + stride, ... over a batch
+typedef struct L1Worker {
+  pthread_t thread;
+  uint32_t first;
+  uint32_t stride;
+  Batch *batch;
+} L1Worker;
+
+static void *
+run_l1_worker(void *arg)
+{
+  L1Worker *worker = (L1Worker *) arg;
+
+  for (uint32_t core = worker->first; core < numCores; core += worker->stride) {
+    CoreBatch *coreBatch = worker->batch->coreBatches + core;
+    l1cache_access_batch(core, coreBatch->addrs, coreBatch->i_or_d,
+                         coreBatch->n, coreBatch->actions, coreBatch->victims);
+  }
+  return NULL;
+}
+
+static void
+alloc_batch(Batch *batch)
+{
+  batch->cores = (uint32_t *) malloc(BATCH_SIZE * sizeof(uint32_t));
+  batch->coreBatches = (CoreBatch *) calloc(numCores, sizeof(CoreBatch));
+  for (uint32_t core = 0; core < numCores; core++) {
+    CoreBatch *coreBatch = batch->coreBatches + core;
+    coreBatch->addrs = (addr_t *) malloc(BATCH_SIZE * sizeof(addr_t));
+    coreBatch->i_or_d = (char *) malloc(BATCH_SIZE);
+    coreBatch->actions = (uint8_t *) malloc(BATCH_SIZE);
+    coreBatch->victims = (addr_t *) malloc(BATCH_SIZE * sizeof(addr_t));
+  }
+}
+
+static void
+free_batch(Batch *batch)
+{
+  for (uint32_t core = 0; core < numCores; core++) {
+    free(batch->coreBatches[core].addrs);
+    free(batch->coreBatches[core].i_or_d);
+    free(batch->coreBatches[core].actions);
+    free(batch->coreBatches[core].victims);
+  }
+  free(batch->coreBatches);
+  free(batch->cores);
+}
+
+// Read the next batch of interleaved accesses, split by core
+static void
+read_batch(Batch *batch)
+{
+  int core;
+
+  batch->n = 0;
+  for (core = 0; core < numCores; core++) {
+    batch->coreBatches[core].n = 0;
+  }
+  while (batch->n < BATCH_SIZE && (core = next_core()) >= 0) {
+    CoreTrace *trace = coreTraces + core;
+    CoreBatch *coreBatch = batch->coreBatches + core;
+
+    coreBatch->addrs[coreBatch->n] = trace->addr;
+    coreBatch->i_or_d[coreBatch->n] = trace->i_or_d;
+    coreBatch->n++;
+    batch->cores[batch->n++] = core;
+
+    read_core_access(trace);
+  }
+}
+
+// Simulate the interleaved accesses a batch at a time.  While the L1s
+// of the cores run over one batch on their threads, the next batch is
+// read; the L1 misses then go through the L2 in the interleaved order.
+static void
+simulate_parallel(uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  uint32_t threads = numThreads;
+  if (threads == 0 || threads > numCores) {
+    threads = numCores;
+  }
+
+  L1Worker *workers = (L1Worker *) calloc(threads, sizeof(L1Worker));
+  uint32_t *cursors = (uint32_t *) calloc(numCores, sizeof(uint32_t));
+  Batch batches[2];
+  Batch *batch = batches;
+  Batch *nextBatch = batches + 1;
+
+  alloc_batch(batch);
+  alloc_batch(nextBatch);
+  read_batch(batch);
+
+  while (batch->n > 0) {
+    // Run the L1s of all cores while reading ahead
+    for (uint32_t i = 0; i < threads; i++) {
+      workers[i].first = i;
+      workers[i].stride = threads;
+      workers[i].batch = batch;
+      pthread_create(&workers[i].thread, NULL, run_l1_worker, workers + i);
+    }
+    read_batch(nextBatch);
+    for (uint32_t i = 0; i < threads; i++) {
+      pthread_join(workers[i].thread, NULL);
+    }
+
+    // Send the L1 misses and writes to the L2 in the interleaved order
+    memset(cursors, 0, numCores * sizeof(uint32_t));
+    for (uint32_t i = 0; i < batch->n; i++) {
+      uint32_t core = batch->cores[i];
+      CoreBatch *coreBatch = batch->coreBatches + core;
+      uint32_t j = cursors[core]++;
+      uint32_t penalty;
+
+      if (coreBatch->actions[j]) {
+        penalty = l1cache_complete(core, coreBatch->addrs[j],
+                                   coreBatch->i_or_d[j], coreBatch->actions[j],
+                                   coreBatch->victims[j]);
+      } else {
+        penalty = coreBatch->i_or_d[j] == 'I' ? icacheHitTime : dcacheHitTime;
+      }
+      coreRefs[core]++;
+      corePenalties[core] += penalty;
+      *totalRefs += 1;
+      *totalPenalties += penalty;
+    }
+
+    Batch *done = batch;
+    batch = nextBatch;
+    nextBatch = done;
+  }
+
+  free_batch(batches);
+  free_batch(batches + 1);
+  free(cursors);
+  free(workers);
+}
+
+void
+simulate_multicore(FILE **traces, uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  coreRefs = (uint64_t *) calloc(numCores, sizeof(uint64_t));
+  corePenalties = (uint64_t *) calloc(numCores, sizeof(uint64_t));
+
+  coreTraces = (CoreTrace *) calloc(numCores, sizeof(CoreTrace));
+  for (uint32_t core = 0; core < numCores; core++) {
+    coreTraces[core].stream = traces[core];
+    read_core_access(coreTraces + core);
+  }
+  rrNextCore = 0;
+
+  // Back-invalidations from an inclusive L2 tie every L1 to the L2 order
+  if (inclusive || numThreads == 1) {
+    simulate_serial(totalRefs, totalPenalties);
+  } else {
+    simulate_parallel(totalRefs, totalPenalties);
+  }
+
+  for (uint32_t core = 0; core < numCores; core++) {
+    free(coreTraces[core].buf);
+  }
+  free(coreTraces);
+}
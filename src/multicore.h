@@ -0,0 +1,48 @@
+//========================================================//
+//  multicore.h                                           //
+//  Header file for the multi-core trace driver           //
+//                                                        //
+//  Interleaves one trace per core into the per-core      //
+//  I$/D$ and the shared L2$                              //
+//========================================================//
+
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Global Defines            //
+//------------------------------------//
+
+#define INTERLEAVE_RR   0  // One access from each core in turn
+#define INTERLEAVE_TIME 1  // Accesses ordered by their trace timestamps
+
+//------------------------------------//
+//      Multi-core Configuration      //
+//------------------------------------//
+
+extern uint32_t interleave;  // How the core traces are interleaved
+extern uint32_t numThreads;  // Threads simulating the L1s (0 for one per core)
+
+//------------------------------------//
+//        Multi-core Statistics       //
+//------------------------------------//
+
+extern uint64_t *coreRefs;       // Memory accesses of each core
+extern uint64_t *corePenalties;  // Memory penalties of each core
+
+//------------------------------------//
+//   Multi-core Function Prototypes   //
+//------------------------------------//
+
+// Simulate the traces of all numCores cores, 'traces[i]' being the trace
+// of core i, and add the accesses and penalties of all cores to the totals.
+// The cache must have been initialized with init_cache.
+//
+void simulate_multicore(FILE **traces,
+                        uint64_t *totalRefs, uint64_t *totalPenalties);
+
+#endif
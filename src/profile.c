@@ -0,0 +1,181 @@
+//========================================================//
+//  profile.c                                             //
+//  Source file for the simulator self-profiling          //
+//                                                        //
+//  The host counters are opened with perf_event_open as  //
+//  one group, so they count over the same cycles, and    //
+//  are reported as unavailable elsewhere or when the     //
+//  kernel does not allow them                            //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "profile.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+//------------------------------------//
+//       Profile Configuration        //
+//------------------------------------//
+
+uint32_t profile = FALSE;
+
+//------------------------------------//
+//      Profile Data Structures       //
+//------------------------------------//
+
+const char *phaseNames[NUM_PHASES] = { "read", "parse", "simulate", "report" };
+
+double phaseSeconds[NUM_PHASES];  // Accumulated wall time of each phase
+struct timespec phaseStart[NUM_PHASES];
+
+#define NUM_COUNTERS 4
+
+const char *counterNames[NUM_COUNTERS] = {
+  "cycles", "instructions", "LLC misses", "branch misses"
+};
+
+int counterFds[NUM_COUNTERS];
+int groupFd;  // The first counter opened, which leads the group
+
+//------------------------------------//
+//         Profile Functions          //
+//------------------------------------//
+
+void
+init_profile()
+{
+  memset(phaseSeconds, 0, sizeof(phaseSeconds));
+
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    counterFds[i] = -1;
+  }
+  groupFd = -1;
+
+#ifdef __linux__
+  const uint64_t configs[NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Only the leader is disabled; the members follow it
+    attr.disabled = groupFd < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    counterFds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    if (counterFds[i] >= 0 && groupFd < 0) {
+      groupFd = counterFds[i];
+    }
+  }
+#endif
+}
+
+void
+profile_start(int phase)
+{
+  clock_gettime(CLOCK_MONOTONIC, phaseStart + phase);
+
+#ifdef __linux__
+  if (phase == PHASE_SIMULATE && groupFd >= 0) {
+    ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+void
+profile_stop(int phase)
+{
+  struct timespec now;
+
+#ifdef __linux__
+  if (phase == PHASE_SIMULATE && groupFd >= 0) {
+    ioctl(groupFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  phaseSeconds[phase] += (now.tv_sec - phaseStart[phase].tv_sec) +
+                         (now.tv_nsec - phaseStart[phase].tv_nsec) * 1e-9;
+}
+
+void
+print_profile(uint64_t totalRefs)
+{
+  double totalSeconds = 0;
+  uint64_t counts[NUM_COUNTERS];
+  // The group read: counters, time enabled, time running, then the
+  // counts of the counters in the order they were opened
+  uint64_t group[3 + NUM_COUNTERS];
+  double scale = 0;
+
+  fprintf(stderr,"Profile:\n");
+  fprintf(stderr,"  phase         wall time      refs/sec\n");
+  for (int i = 0; i < NUM_PHASES; i++) {
+    totalSeconds += phaseSeconds[i];
+    fprintf(stderr,"  %-9s %11.3f s", phaseNames[i], phaseSeconds[i]);
+    if (phaseSeconds[i] > 0) {
+      fprintf(stderr," %13.0f\n", totalRefs / phaseSeconds[i]);
+    } else {
+      fprintf(stderr,"             -\n");
+    }
+  }
+  fprintf(stderr,"  %-9s %11.3f s", "total", totalSeconds);
+  if (totalSeconds > 0) {
+    fprintf(stderr," %13.0f\n", totalRefs / totalSeconds);
+  } else {
+    fprintf(stderr,"             -\n");
+  }
+
+  // Scale the counts up if the group was multiplexed with other events
+  if (groupFd >= 0 && read(groupFd, group, sizeof(group)) >= (ssize_t)(3 * sizeof(uint64_t)) &&
+      group[2] > 0) {
+    scale = (double)group[1] / group[2];
+  }
+
+  fprintf(stderr,"Host Counters (simulate):\n");
+  for (int i = 0, n = 0; i < NUM_COUNTERS; i++) {
+    counts[i] = 0;
+    if (counterFds[i] < 0 || scale == 0 || n >= group[0]) {
+      fprintf(stderr,"  %-14s          unavailable\n", counterNames[i]);
+      counterFds[i] = -1;
+      continue;
+    }
+    counts[i] = group[3 + n++] * scale;
+    fprintf(stderr,"  %-14s %20lu", counterNames[i], counts[i]);
+    if (totalRefs > 0) {
+      fprintf(stderr,"  (%.2f per ref)", (double)counts[i] / totalRefs);
+    }
+    fprintf(stderr,"\n");
+  }
+  if (counterFds[0] >= 0 && counterFds[1] >= 0 && counts[0] > 0) {
+    fprintf(stderr,"  IPC            %20.2f\n", (double)counts[1] / counts[0]);
+  }
+  if (scale > 1) {
+    fprintf(stderr,"  (scaled: the counters ran %.0f%% of the time)\n", 100 / scale);
+  }
+
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counterFds[i] >= 0) {
+      close(counterFds[i]);
+    }
+  }
+}
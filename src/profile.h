@@ -0,0 +1,53 @@
+//========================================================//
+//  profile.h                                             //
+//  Header file for the simulator self-profiling          //
+//                                                        //
+//  Phase wall-clock timers and, on Linux, host hardware  //
+//  counters around the simulation                        //
+//========================================================//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Global Defines            //
+//------------------------------------//
+
+#define PHASE_READ     0  // Reading the trace bytes
+#define PHASE_PARSE    1  // Parsing the trace lines
+#define PHASE_SIMULATE 2  // Running the accesses through the caches
+#define PHASE_REPORT   3  // Printing the statistics
+#define NUM_PHASES     4
+
+// Trace bytes read per profiled batch
+#define PROFILE_BATCH_BYTES (1 << 20)
+
+//------------------------------------//
+//       Profile Configuration        //
+//------------------------------------//
+
+extern uint32_t profile;  // Indicates if the run is profiled
+
+//------------------------------------//
+//     Profile Function Prototypes    //
+//------------------------------------//
+
+// Open the host counters, which count only while a PHASE_SIMULATE
+// timer runs
+//
+void init_profile();
+
+// Start and stop the timer of 'phase'.  Call these once per batch, not
+// once per access.
+//
+void profile_start(int phase);
+void profile_stop(int phase);
+
+// Print the time of each phase and the host counters to stderr
+//
+void print_profile(uint64_t totalRefs);
+
+#endif
@@ -0,0 +1,472 @@
+//========================================================//
+//  simpoint.c                                            //
+//  Source file for representative interval selection     //
+//                                                        //
+//  Each interval's signature is the random projection of //
+//  its block-address and region frequencies.  Intervals  //
+//  are clustered with k-means, and the interval nearest  //
+//  each centroid stands for its cluster, weighted by the //
+//  share of the references the cluster covers.           //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <float.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "cache.h"
+#include "simpoint.h"
+#include "store.h"
+
+//------------------------------------//
+//       SimPoint Configuration       //
+//------------------------------------//
+
+const char *simpointAnalyze = NULL;
+const char *simpointReplay  = NULL;
+uint32_t simpointInterval   = 1000000;
+uint32_t simpointMaxK       = 10;
+uint32_t simpointWarmup     = 100000;
+
+//------------------------------------//
+//      SimPoint Data Structures      //
+//------------------------------------//
+
+#define KMEANS_ITERATIONS 100
+#define MAX_SIMPOINTS     1024  // Simulation points read for a replay
+
+#define SALT_BLOCK  0x5bd1e9955bd1e995ULL
+#define SALT_REGION 0xc2b2ae3d27d4eb4fULL
+
+typedef struct SimPoint {
+  uint32_t interval;
+  double weight;
+} SimPoint;
+
+// The statistics that are combined across simulation points
+uint64_t * const replayStats[] = {
+  &icacheRefs,  &icacheMisses,  &icachePenalties,
+  &dcacheRefs,  &dcacheMisses,  &dcachePenalties,
+  &l2cacheRefs, &l2cacheMisses, &l2cachePenalties,
+  &dcacheStores, &dcacheWritebacks, &dcacheWritebackPenalties,
+  &l2cacheWritebacks, &l2cacheWritebackPenalties,
+  &memReads, &memWrites,
+};
+
+#define NUM_REPLAY_STATS (sizeof(replayStats) / sizeof(replayStats[0]))
+
+char *simpointBuf = NULL;
+size_t simpointLen = 0;
+
+uint32_t replayPoints;    // Simulation points of the replay
+uint32_t replayInterval;  // References per replayed interval
+
+//------------------------------------//
+//        SimPoint Functions          //
+//------------------------------------//
+
+static uint64_t
+splitmix64(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Add the random +-1 projection of 'feature' to 'counts'
+static inline void
+project(int64_t *counts, uint64_t feature)
+{
+  uint64_t bits = splitmix64(feature);
+  for (int d = 0; d < SIGNATURE_DIMS; d++) {
+    counts[d] += (int64_t)((bits >> d) & 1) * 2 - 1;
+  }
+}
+
+// Reads a line of the trace like read_mem_access
+//
+// Returns True if Successful
+//
+static int
+read_trace_line(FILE *trace, addr_t *addr, char *i_or_d)
+{
+  uint64_t wideAddr = 0;
+
+  if (getline(&simpointBuf, &simpointLen, trace) == -1) {
+    return 0;
+  }
+  sscanf(simpointBuf,"0x%" SCNx64 " %c\n",&wideAddr,i_or_d);
+  *addr = TRACE_ADDR(wideAddr);
+  return 1;
+}
+
+static double
+distance2(const double *a, const double *b)
+{
+  double sum = 0;
+  for (int d = 0; d < SIGNATURE_DIMS; d++) {
+    sum += (a[d] - b[d]) * (a[d] - b[d]);
+  }
+  return sum;
+}
+
+// Cluster the 'n' signatures into 'k' clusters, seeded k-means++ style
+// from a fixed seed so that the analysis is repeatable
+static void
+kmeans(const double *sigs, uint32_t n, uint32_t k, uint32_t *assign,
+       double *centroids)
+{
+  double *nearest = (double *) malloc(n * sizeof(double));
+  uint32_t *sizes = (uint32_t *) malloc(k * sizeof(uint32_t));
+  uint64_t rng = 1;
+
+  // Seed each further centroid with a point sampled in proportion to its
+  // squared distance from the centroids chosen so far
+  memcpy(centroids, sigs, SIGNATURE_DIMS * sizeof(double));
+  for (uint32_t c = 1; c < k; c++) {
+    double total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      nearest[i] = DBL_MAX;
+      for (uint32_t j = 0; j < c; j++) {
+        double dist = distance2(sigs + i * SIGNATURE_DIMS,
+                                centroids + j * SIGNATURE_DIMS);
+        if (dist < nearest[i]) {
+          nearest[i] = dist;
+        }
+      }
+      total += nearest[i];
+    }
+    rng = splitmix64(rng);
+    double target = total * (double)(rng >> 11) / (double)(1ULL << 53);
+    uint32_t pick = 0;
+    for (pick = 0; pick + 1 < n && target >= nearest[pick]; pick++) {
+      target -= nearest[pick];
+    }
+    memcpy(centroids + c * SIGNATURE_DIMS, sigs + pick * SIGNATURE_DIMS,
+           SIGNATURE_DIMS * sizeof(double));
+  }
+
+  for (uint32_t i = 0; i < n; i++) {
+    assign[i] = k;
+  }
+  for (int iter = 0; iter < KMEANS_ITERATIONS; iter++) {
+    uint32_t changed = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t best = 0;
+      double bestDist = DBL_MAX;
+      for (uint32_t c = 0; c < k; c++) {
+        double dist = distance2(sigs + i * SIGNATURE_DIMS,
+                                centroids + c * SIGNATURE_DIMS);
+        if (dist < bestDist) {
+          bestDist = dist;
+          best = c;
+        }
+      }
+      if (assign[i] != best) {
+        assign[i] = best;
+        changed++;
+      }
+    }
+    if (!changed) {
+      break;
+    }
+
+    memset(centroids, 0, k * SIGNATURE_DIMS * sizeof(double));
+    memset(sizes, 0, k * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+      sizes[assign[i]]++;
+      for (int d = 0; d < SIGNATURE_DIMS; d++) {
+        centroids[assign[i] * SIGNATURE_DIMS + d] += sigs[i * SIGNATURE_DIMS + d];
+      }
+    }
+    for (uint32_t c = 0; c < k; c++) {
+      for (int d = 0; d < SIGNATURE_DIMS && sizes[c]; d++) {
+        centroids[c * SIGNATURE_DIMS + d] /= sizes[c];
+      }
+    }
+  }
+
+  free(sizes);
+  free(nearest);
+}
+
+void
+simpoint_analyze(FILE *trace)
+{
+  uint32_t blockBits = 0;
+  while (blocksize >> blockBits > 1)
+    blockBits += 1;
+
+  uint32_t capacity = 64;
+  uint32_t numIntervals = 0;
+  double *sigs = (double *) malloc(capacity * SIGNATURE_DIMS * sizeof(double));
+  uint64_t *lengths = (uint64_t *) malloc(capacity * sizeof(uint64_t));
+  int64_t counts[SIGNATURE_DIMS];
+  uint64_t refs = 0;
+  uint64_t intervalRefs = 0;
+  addr_t addr = 0;
+  char i_or_d = '\0';
+
+  memset(counts, 0, sizeof(counts));
+
+  // Build the signature of each interval
+  while (TRUE) {
+    int more = read_trace_line(trace, &addr, &i_or_d);
+    if (more) {
+      project(counts, (addr >> blockBits) ^ SALT_BLOCK);
+      project(counts, (addr >> REGION_BITS) ^ SALT_REGION);
+      intervalRefs++;
+      refs++;
+    }
+
+    if (intervalRefs == simpointInterval || (!more && intervalRefs > 0)) {
+      if (numIntervals == capacity) {
+        capacity *= 2;
+        sigs = (double *) realloc(sigs, capacity * SIGNATURE_DIMS * sizeof(double));
+        lengths = (uint64_t *) realloc(lengths, capacity * sizeof(uint64_t));
+      }
+      // Frequencies rather than counts, so a short last interval compares
+      for (int d = 0; d < SIGNATURE_DIMS; d++) {
+        sigs[numIntervals * SIGNATURE_DIMS + d] =
+            (double)counts[d] / (double)intervalRefs;
+      }
+      lengths[numIntervals++] = intervalRefs;
+      memset(counts, 0, sizeof(counts));
+      intervalRefs = 0;
+    }
+    if (!more) {
+      break;
+    }
+  }
+
+  if (numIntervals == 0) {
+    fprintf(stderr,"SimPoint Error the trace is empty\n");
+    exit(1);
+  }
+
+  uint32_t k = simpointMaxK < numIntervals ? simpointMaxK : numIntervals;
+  if (k == 0) {
+    k = 1;
+  }
+  uint32_t *assign = (uint32_t *) malloc(numIntervals * sizeof(uint32_t));
+  double *centroids = (double *) malloc(k * SIGNATURE_DIMS * sizeof(double));
+  kmeans(sigs, numIntervals, k, assign, centroids);
+
+  FILE *out = fopen(simpointAnalyze, "w");
+  if (out == NULL) {
+    fprintf(stderr,"SimPoint Error could not write %s\n", simpointAnalyze);
+    exit(1);
+  }
+  fprintf(out, "interval %u\n", simpointInterval);
+  fprintf(out, "refs %" PRIu64 "\n", refs);
+
+  printf("SimPoint Analysis:\n");
+  printf("  References:  %" PRIu64 "\n", refs);
+  printf("  Intervals:   %u of %u references\n", numIntervals, simpointInterval);
+  printf("  Clusters:    %u\n", k);
+  printf("  Simulation Points:\n");
+
+  // The interval nearest each centroid stands for its cluster
+  for (uint32_t c = 0; c < k; c++) {
+    uint64_t clusterRefs = 0;
+    int32_t best = -1;
+    double bestDist = DBL_MAX;
+
+    for (uint32_t i = 0; i < numIntervals; i++) {
+      if (assign[i] != c) {
+        continue;
+      }
+      clusterRefs += lengths[i];
+      double dist = distance2(sigs + i * SIGNATURE_DIMS,
+                              centroids + c * SIGNATURE_DIMS);
+      if (dist < bestDist) {
+        bestDist = dist;
+        best = i;
+      }
+    }
+    if (best < 0) {
+      continue;
+    }
+
+    double weight = (double)clusterRefs / (double)refs;
+    fprintf(out, "simpoint %d %.9f\n", best, weight);
+    printf("    interval %6d  weight %.4f\n", best, weight);
+  }
+  fclose(out);
+
+  free(centroids);
+  free(assign);
+  free(lengths);
+  free(sigs);
+  free(simpointBuf);
+}
+
+static int
+compare_simpoints(const void *a, const void *b)
+{
+  const SimPoint *x = (const SimPoint *) a;
+  const SimPoint *y = (const SimPoint *) b;
+  return (x->interval > y->interval) - (x->interval < y->interval);
+}
+
+void
+simpoint_replay(FILE *trace, uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  char line[256];
+  uint32_t interval = 0;
+  uint64_t traceRefs = 0;
+  uint32_t numPoints = 0;
+  SimPoint points[MAX_SIMPOINTS];
+
+  FILE *in = fopen(simpointReplay, "r");
+  if (in == NULL) {
+    fprintf(stderr,"SimPoint Error could not read %s\n", simpointReplay);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), in) != NULL) {
+    if (sscanf(line, "interval %u", &interval) == 1 ||
+        sscanf(line, "refs %" SCNu64, &traceRefs) == 1) {
+      continue;
+    }
+    if (numPoints < MAX_SIMPOINTS &&
+        sscanf(line, "simpoint %u %lf", &points[numPoints].interval,
+               &points[numPoints].weight) == 2) {
+      numPoints++;
+    }
+  }
+  fclose(in);
+
+  if (interval == 0 || numPoints == 0) {
+    fprintf(stderr,"SimPoint Error %s has no simulation points\n",
+        simpointReplay);
+    exit(1);
+  }
+  qsort(points, numPoints, sizeof(SimPoint), compare_simpoints);
+
+  // Weighted sums of the statistics, references and penalties
+  double weighted[NUM_REPLAY_STATS + 2];
+  memset(weighted, 0, sizeof(weighted));
+
+  uint64_t pos = 0;
+  addr_t addr = 0;
+  char i_or_d = '\0';
+
+  for (uint32_t p = 0; p < numPoints; p++) {
+    uint64_t start = (uint64_t)points[p].interval * interval;
+    uint64_t warmStart = start > simpointWarmup ? start - simpointWarmup : 0;
+    uint64_t refs = 0;
+    uint64_t penalties = 0;
+
+    // Skip to the warmup without parsing
+    while (pos < warmStart &&
+           getline(&simpointBuf, &simpointLen, trace) != -1) {
+      pos++;
+    }
+
+    // Functional warmup, whose statistics are dropped
+    while (pos < start && read_trace_line(trace, &addr, &i_or_d)) {
+      if (i_or_d == 'I') {
+        icache_access(addr);
+      } else if (i_or_d == 'W') {
+        dcache_write(addr);
+      } else {
+        dcache_access(addr);
+      }
+      pos++;
+    }
+    for (int i = 0; i < NUM_REPLAY_STATS; i++) {
+      *replayStats[i] = 0;
+    }
+
+    while (pos < start + interval && read_trace_line(trace, &addr, &i_or_d)) {
+      if (i_or_d == 'I') {
+        penalties += icache_access(addr);
+      } else if (i_or_d == 'D' || i_or_d == 'R') {
+        penalties += dcache_access(addr);
+      } else if (i_or_d == 'W') {
+        penalties += dcache_write(addr);
+      } else {
+        fprintf(stderr,"Input Error '%c' must be one of 'I', 'D', 'R' or 'W'\n",
+            i_or_d);
+        exit(1);
+      }
+      refs++;
+      pos++;
+    }
+
+    for (int i = 0; i < NUM_REPLAY_STATS; i++) {
+      weighted[i] += points[p].weight * *replayStats[i];
+    }
+    weighted[NUM_REPLAY_STATS] += points[p].weight * refs;
+    weighted[NUM_REPLAY_STATS + 1] += points[p].weight * penalties;
+  }
+
+  // Scale the weighted statistics to the length of the whole trace
+  double scale = 0;
+  if (weighted[NUM_REPLAY_STATS] > 0) {
+    scale = (double)traceRefs / weighted[NUM_REPLAY_STATS];
+  }
+  for (int i = 0; i < NUM_REPLAY_STATS; i++) {
+    *replayStats[i] = (uint64_t)(weighted[i] * scale + 0.5);
+  }
+  *totalRefs = (uint64_t)(weighted[NUM_REPLAY_STATS] * scale + 0.5);
+  *totalPenalties = (uint64_t)(weighted[NUM_REPLAY_STATS + 1] * scale + 0.5);
+
+  replayPoints = numPoints;
+  replayInterval = interval;
+
+  free(simpointBuf);
+}
+
+// Miss rates of the I$, D$ and L2$ and the average access time
+static void
+replay_metrics(double *metrics, uint64_t totalRefs, uint64_t totalPenalties)
+{
+  metrics[0] = icacheRefs ? 100.0 * icacheMisses / icacheRefs : 0;
+  metrics[1] = dcacheRefs ? 100.0 * dcacheMisses / dcacheRefs : 0;
+  metrics[2] = l2cacheRefs ? 100.0 * l2cacheMisses / l2cacheRefs : 0;
+  metrics[3] = totalRefs ? (double)totalPenalties / totalRefs : 0;
+}
+
+void
+simpoint_print_error(FILE *trace, uint64_t totalRefs, uint64_t totalPenalties)
+{
+  const char *names[4] = {
+    "I-cache miss rate", "D-cache miss rate", "L2-cache miss rate",
+    "avg Memory access time"
+  };
+  const uint32_t present[4] = { icacheSets, dcacheSets, l2cacheSets, TRUE };
+  double estimate[4];
+  double full[4];
+  uint64_t fullRefs = 0;
+  uint64_t fullPenalties = 0;
+
+  printf("SimPoint Replay:\n");
+  printf("  Simulation Points: %u of %u references\n",
+      replayPoints, replayInterval);
+  printf("  Warmup:            %u references\n", simpointWarmup);
+
+  replay_metrics(estimate, totalRefs, totalPenalties);
+
+  printf("SimPoint Error vs Full Run:\n");
+  if (storeMode == STORE_BYPASS ||
+      !store_lookup(trace, &fullRefs, &fullPenalties)) {
+    printf("  full run not in the result store, simulate the whole trace once\n");
+    return;
+  }
+  replay_metrics(full, fullRefs, fullPenalties);
+
+  for (int i = 0; i < 4; i++) {
+    if (!present[i]) {
+      continue;
+    }
+    printf("  %-23s %10.2f vs %10.2f  (", names[i], estimate[i], full[i]);
+    if (full[i] > 0) {
+      printf("%+.2f%%)\n", 100.0 * (estimate[i] - full[i]) / full[i]);
+    } else {
+      printf("-)\n");
+    }
+  }
+}
@@ -0,0 +1,56 @@
+//========================================================//
+//  simpoint.h                                            //
+//  Header file for representative interval selection     //
+//                                                        //
+//  Picks weighted simulation points from a trace and     //
+//  replays only those intervals                          //
+//========================================================//
+
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Global Defines            //
+//------------------------------------//
+
+#define SIGNATURE_DIMS 32  // Dimensions of the projected interval signatures
+#define REGION_BITS    12  // Address bits below the region of an access
+
+//------------------------------------//
+//       SimPoint Configuration       //
+//------------------------------------//
+
+extern const char *simpointAnalyze;  // File to write simulation points to
+extern const char *simpointReplay;   // File to read simulation points from
+extern uint32_t simpointInterval;    // References per interval
+extern uint32_t simpointMaxK;        // Clusters, and so simulation points
+extern uint32_t simpointWarmup;      // References simulated before a point
+
+//------------------------------------//
+//    SimPoint Function Prototypes    //
+//------------------------------------//
+
+// Split the trace into intervals, cluster their signatures and write the
+// weighted simulation points to simpointAnalyze
+//
+void simpoint_analyze(FILE *trace);
+
+// Simulate only the intervals listed in simpointReplay, each after a
+// functional warmup, and leave their weighted statistics, scaled to the
+// whole trace, in the cache statistics and the totals.
+// The cache must have been initialized with init_cache.
+//
+void simpoint_replay(FILE *trace, uint64_t *totalRefs, uint64_t *totalPenalties);
+
+// Print the replayed simulation points and how the estimate compares to
+// a full run of the trace from the result store.  Overwrites the cache
+// statistics with those of the full run.
+//
+void simpoint_print_error(FILE *trace, uint64_t totalRefs,
+                          uint64_t totalPenalties);
+
+#endif
@@ -0,0 +1,364 @@
+//========================================================//
+//  store.c                                               //
+//  Source file for the on-disk result store              //
+//                                                        //
+//  Each entry lives in its own file under storeDir,      //
+//  named after the hash of (trace digest, configuration, //
+//  simulator version).  Regular trace files also get a   //
+//  hint from their file identity to their digest so the  //
+//  trace need not be reread to find its entry.  Piped    //
+//  traces are only digested as they are simulated.       //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+#include "store.h"
+#include "timing.h"
+
+//------------------------------------//
+//        Store Configuration         //
+//------------------------------------//
+
+const char *storeDir = STORE_DEFAULT_DIR;
+uint32_t storeMode   = STORE_USE;
+uint32_t storeDigest = FALSE;
+
+//------------------------------------//
+//         Store Data Structures      //
+//------------------------------------//
+
+#define DIGEST_SEED  0xcbf29ce484222325ULL
+#define DIGEST_PRIME 0x9e3779b97f4a7c15ULL
+
+uint64_t traceDigest;  // Running digest of the trace bytes
+uint64_t traceBytes;   // Number of trace bytes folded into the digest
+uint64_t digestTail;   // Bytes of the last, partial word
+
+#define DIGEST_READ_BYTES (1 << 16)  // Bytes read per fread of a digest pass
+
+// The statistics saved in every entry, in file order
+typedef struct StoredStat {
+  const char *name;
+  uint64_t *value;
+} StoredStat;
+
+StoredStat storedStats[] = {
+  { "icacheRefs",       &icacheRefs       },
+  { "icacheMisses",     &icacheMisses     },
+  { "icachePenalties",  &icachePenalties  },
+  { "dcacheRefs",       &dcacheRefs       },
+  { "dcacheMisses",     &dcacheMisses     },
+  { "dcachePenalties",  &dcachePenalties  },
+  { "l2cacheRefs",      &l2cacheRefs      },
+  { "l2cacheMisses",    &l2cacheMisses    },
+  { "l2cachePenalties", &l2cachePenalties },
+  { "dcacheStores",              &dcacheStores              },
+  { "dcacheWritebacks",          &dcacheWritebacks          },
+  { "dcacheWritebackPenalties",  &dcacheWritebackPenalties  },
+  { "l2cacheWritebacks",         &l2cacheWritebacks         },
+  { "l2cacheWritebackPenalties", &l2cacheWritebackPenalties },
+  { "memReads",                  &memReads                  },
+  { "memWrites",                 &memWrites                 },
+  { "timingCycles",       &timingCycles       },
+  { "timingLatency",      &timingLatency      },
+  { "overlappedLatency",  &overlappedLatency  },
+  { "mshrMerges",         &mshrMerges         },
+  { "icacheMSHRStalls",   &icacheMSHRStalls   },
+  { "dcacheMSHRStalls",   &dcacheMSHRStalls   },
+  { "l2cacheMSHRStalls",  &l2cacheMSHRStalls  },
+  { "memRequests",        &memRequests        },
+  { "memQueueDelay",      &memQueueDelay      },
+  { "memQueueFullStalls", &memQueueFullStalls },
+  { "memQueueOccupancy",  &memQueueOccupancy  },
+  { "memQueueMax",        &memQueueMax        },
+};
+
+#define NUM_STORED_STATS (sizeof(storedStats) / sizeof(storedStats[0]))
+
+//------------------------------------//
+//          Store Functions           //
+//------------------------------------//
+
+// Fold one 64-bit word into the hash 'h'
+static uint64_t
+mix(uint64_t h, uint64_t word)
+{
+  h ^= word;
+  h *= DIGEST_PRIME;
+  return h ^ (h >> 32);
+}
+
+static uint64_t
+hash_string(uint64_t h, const char *s)
+{
+  size_t len = strlen(s);
+  for (size_t i = 0; i < len; i++) {
+    h = mix(h, (uint8_t)s[i]);
+  }
+  return mix(h, len);
+}
+
+void
+digest_init()
+{
+  traceDigest = DIGEST_SEED;
+  traceBytes  = 0;
+  digestTail  = 0;
+}
+
+// Consumes the bytes 8 at a time so the digest costs a couple of
+// multiplies per trace line.  A partial word is carried to the next
+// call, so the digest does not depend on how the bytes are split.
+void
+digest_update(const char *bytes, size_t len)
+{
+  uint64_t word;
+  size_t filled = traceBytes % 8;
+
+  traceBytes += len;
+  if (filled) {
+    size_t n = len < 8 - filled ? len : 8 - filled;
+    memcpy((char *)&digestTail + filled, bytes, n);
+    if (filled + n < 8) {
+      return;
+    }
+    traceDigest = mix(traceDigest, digestTail);
+    bytes += n;
+    len   -= n;
+  }
+  while (len >= 8) {
+    memcpy(&word, bytes, 8);
+    traceDigest = mix(traceDigest, word);
+    bytes += 8;
+    len   -= 8;
+  }
+  digestTail = 0;
+  memcpy(&digestTail, bytes, len);
+}
+
+// Returns the digest of all the bytes passed to digest_update
+static uint64_t
+digest_value()
+{
+  uint64_t h = traceDigest;
+  uint64_t tail = traceBytes % 8;
+
+  if (tail) {
+    // Tag the tail with its length in the (otherwise zero) top byte
+    h = mix(h, digestTail ^ (tail << 56));
+  }
+  return mix(h, traceBytes);
+}
+
+// Returns the digest of the whole file open on 'trace', which is left
+// at the position it had
+static uint64_t
+digest_file(FILE *trace)
+{
+  char *bytes = (char *) malloc(DIGEST_READ_BYTES);
+  off_t pos = ftello(trace);
+  size_t n;
+
+  rewind(trace);
+  digest_init();
+  while ((n = fread(bytes, 1, DIGEST_READ_BYTES, trace)) > 0) {
+    digest_update(bytes, n);
+  }
+  clearerr(trace);
+  fseeko(trace, pos, SEEK_SET);
+  free(bytes);
+
+  return digest_value();
+}
+
+// Write a description of everything that affects the simulated
+// statistics into 'buf'
+static void
+describe_config(char *buf, size_t size)
+{
+  snprintf(buf, size,
+      "version=%d addrbits=%u icache=%u:%u:%u dcache=%u:%u:%u l2cache=%u:%u:%u "
+      "inclusive=%u writethrough=%u writeallocate=%u "
+      "blocksize=%u memspeed=%u "
+      "timing=%u mshrs=%u:%u membw=%u memqueue=%u",
+      SIM_VERSION, (unsigned)(sizeof(addr_t) * 8),
+      icacheSets, icacheAssoc, icacheHitTime,
+      dcacheSets, dcacheAssoc, dcacheHitTime,
+      l2cacheSets, l2cacheAssoc, l2cacheHitTime,
+      inclusive, writeThrough, writeAllocate, blocksize, memspeed,
+      timingModel, l1MSHRs, l2MSHRs, membw, memqueue);
+}
+
+// Get the path of the hint file for the regular file open on 'trace'
+//
+// Returns True if 'trace' is a regular file
+//
+static int
+hint_path(FILE *trace, char *path, size_t size)
+{
+  struct stat st;
+
+  if (fstat(fileno(trace), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return 0;
+  }
+
+  uint64_t h = DIGEST_SEED;
+  h = mix(h, st.st_dev);
+  h = mix(h, st.st_ino);
+  h = mix(h, st.st_size);
+  h = mix(h, st.st_mtim.tv_sec);
+  h = mix(h, st.st_mtim.tv_nsec);
+
+  snprintf(path, size, "%s/trace-%016" PRIx64, storeDir, h);
+  return 1;
+}
+
+static void
+entry_path(uint64_t digest, const char *config, char *path, size_t size)
+{
+  snprintf(path, size, "%s/result-%016" PRIx64,
+      storeDir, hash_string(digest, config));
+}
+
+// Write 'contents' to 'path' through a temporary file so that a
+// concurrent reader never sees a partial entry
+static void
+write_atomically(const char *path, const char *contents)
+{
+  char tmpPath[4096];
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp.%ld", path, (long)getpid());
+
+  FILE *f = fopen(tmpPath, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Warning: could not write result store entry %s\n", path);
+    return;
+  }
+  fputs(contents, f);
+  if (fclose(f) != 0 || rename(tmpPath, path) != 0) {
+    fprintf(stderr, "Warning: could not write result store entry %s\n", path);
+    unlink(tmpPath);
+  }
+}
+
+int
+store_lookup(FILE *trace, uint64_t *totalRefs, uint64_t *totalPenalties)
+{
+  char hint[4096];
+  char path[4096];
+  char config[512];
+  char line[1024];
+  uint64_t digest;
+  FILE *f = NULL;
+  int hinted = hint_path(trace, hint, sizeof(hint));
+  int digested = FALSE;  // Indicates if the digest was read from the file
+
+  if (hinted && (f = fopen(hint, "r")) != NULL) {
+    // Find the digest of this trace file from its identity
+    int found = fscanf(f, "%" SCNx64, &digest) == 1;
+    fclose(f);
+    if (!found) {
+      return 0;
+    }
+  } else if (hinted && storeDigest) {
+    // An unknown file, or a copy of a known one: read it to find its digest
+    digest = digest_file(trace);
+    digested = TRUE;
+  } else {
+    return 0;
+  }
+
+  describe_config(config, sizeof(config));
+  entry_path(digest, config, path, sizeof(path));
+  f = fopen(path, "r");
+  if (f == NULL) {
+    return 0;
+  }
+
+  // The first line repeats the configuration to guard against collisions
+  char *stored = NULL;
+  if (fgets(line, sizeof(line), f) != NULL && !strncmp(line, "config ", 7)) {
+    stored = strtok(line + 7, "\n");
+  }
+  if (stored == NULL || strcmp(stored, config)) {
+    fclose(f);
+    return 0;
+  }
+
+  uint32_t numRead = 0;
+  char name[64];
+  uint64_t value;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%63s %" SCNu64, name, &value) != 2) {
+      continue;
+    }
+    if (!strcmp(name, "totalRefs")) {
+      *totalRefs = value;
+      numRead++;
+    } else if (!strcmp(name, "totalPenalties")) {
+      *totalPenalties = value;
+      numRead++;
+    } else {
+      for (int i = 0; i < NUM_STORED_STATS; i++) {
+        if (!strcmp(name, storedStats[i].name)) {
+          *storedStats[i].value = value;
+          numRead++;
+          break;
+        }
+      }
+    }
+  }
+  fclose(f);
+
+  if (numRead != NUM_STORED_STATS + 2) {
+    return 0;
+  }
+
+  // Remember the digest so the next run need not reread the file
+  if (hinted && digested) {
+    snprintf(line, sizeof(line), "%016" PRIx64 "\n", digest);
+    write_atomically(hint, line);
+  }
+  return 1;
+}
+
+void
+store_save(FILE *trace, uint64_t totalRefs, uint64_t totalPenalties)
+{
+  char path[4096];
+  char config[512];
+  char contents[4096];
+  int n;
+
+  if (mkdir(storeDir, 0777) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Warning: could not create result store %s\n", storeDir);
+    return;
+  }
+
+  uint64_t digest = digest_value();
+
+  // Remember the digest of a regular file by its identity
+  if (hint_path(trace, path, sizeof(path))) {
+    snprintf(contents, sizeof(contents), "%016" PRIx64 "\n", digest);
+    write_atomically(path, contents);
+  }
+
+  describe_config(config, sizeof(config));
+  entry_path(digest, config, path, sizeof(path));
+
+  n = snprintf(contents, sizeof(contents), "config %s\n", config);
+  for (int i = 0; i < NUM_STORED_STATS; i++) {
+    n += snprintf(contents + n, sizeof(contents) - n, "%s %" PRIu64 "\n",
+        storedStats[i].name, *storedStats[i].value);
+  }
+  snprintf(contents + n, sizeof(contents) - n,
+      "totalRefs %" PRIu64 "\ntotalPenalties %" PRIu64 "\n",
+      totalRefs, totalPenalties);
+
+  write_atomically(path, contents);
+}
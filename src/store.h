@@ -0,0 +1,62 @@
+//========================================================//
+//  store.h                                               //
+//  Header file for the on-disk result store              //
+//                                                        //
+//  Results are keyed by a digest of the trace bytes,     //
+//  the cache configuration and the simulator version     //
+//========================================================//
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Global Defines            //
+//------------------------------------//
+
+#define STORE_USE     0  // Return stored results and save new ones
+#define STORE_BYPASS  1  // Neither read nor write the store
+#define STORE_REFRESH 2  // Always simulate and overwrite the stored entry
+
+#define STORE_DEFAULT_DIR ".cache-results"
+
+//------------------------------------//
+//        Store Configuration         //
+//------------------------------------//
+
+extern const char *storeDir;   // Directory holding the stored results
+extern uint32_t storeMode;     // One of STORE_USE, STORE_BYPASS, STORE_REFRESH
+extern uint32_t storeDigest;   // Read an unknown trace file to find its entry
+
+//------------------------------------//
+//      Store Function Prototypes     //
+//------------------------------------//
+
+// Reset the streaming trace digest
+//
+void digest_init();
+
+// Fold the next 'len' bytes of the trace into the digest
+//
+void digest_update(const char *bytes, size_t len);
+
+// Look up the results for the trace open on 'trace' under the current
+// configuration.  A regular file is found through the hint left by an
+// earlier run or, with storeDigest set, by reading it once to compute
+// its digest; its position is left unchanged.  A piped trace is never
+// found, as it cannot be read twice.  On a hit the cache statistics and
+// the totals are restored.
+//
+// Returns True if the stored results were found
+//
+int store_lookup(FILE *trace, uint64_t *totalRefs, uint64_t *totalPenalties);
+
+// Save the cache statistics and totals of a finished simulation of the
+// trace open on 'trace' under the digest accumulated by digest_update()
+//
+void store_save(FILE *trace, uint64_t totalRefs, uint64_t totalPenalties);
+
+#endif
@@ -0,0 +1,291 @@
+//========================================================//
+//  timing.c                                              //
+//  Source file for the non-blocking timing model         //
+//                                                        //
+//  The core issues one access per cycle and only stalls  //
+//  when the first level it sends the access to cannot    //
+//  take it.  Hits and misses come from the cache         //
+//  functions; this file only decides when each access    //
+//  completes.                                            //
+//========================================================//
+
+#include <stdio.h>
+#include "cache.h"
+#include "timing.h"
+
+//------------------------------------//
+//        Timing Configuration        //
+//------------------------------------//
+
+uint32_t timingModel = FALSE;
+uint32_t l1MSHRs     = 8;
+uint32_t l2MSHRs     = 16;
+uint32_t membw       = 4;
+uint32_t memqueue    = 16;
+
+//------------------------------------//
+//          Timing Statistics         //
+//------------------------------------//
+
+uint64_t timingCycles;
+uint64_t timingLatency;
+uint64_t overlappedLatency;
+uint64_t mshrMerges;
+uint64_t icacheMSHRStalls;
+uint64_t dcacheMSHRStalls;
+uint64_t l2cacheMSHRStalls;
+uint64_t memRequests;
+uint64_t memQueueDelay;
+uint64_t memQueueFullStalls;
+uint64_t memQueueOccupancy;
+uint64_t memQueueMax;
+
+//------------------------------------//
+//       Timing Data Structures       //
+//------------------------------------//
+
+// An outstanding miss for one block, free once 'ready' has passed
+typedef struct MSHR {
+  addr_t blockAddr;
+  uint64_t ready;
+} MSHR;
+
+typedef struct MSHRFile {
+  uint32_t size;
+  MSHR * entries;
+  uint64_t * stalls;  // Statistic charged when the file is full
+} MSHRFile;
+
+MSHRFile iMSHRFile;
+MSHRFile dMSHRFile;
+MSHRFile l2MSHRFile;
+
+uint64_t * memDone;   // Completion time of each memory queue slot
+uint64_t memBusFree;  // Cycle at which the memory bus is next free
+
+uint64_t cycle;       // Cycle at which the next access issues
+addr_t timingBlockMask;
+
+//------------------------------------//
+//          Timing Functions          //
+//------------------------------------//
+
+void createMSHRFile(MSHRFile * file, uint32_t size, uint64_t * stalls) {
+  file->size = size ? size : 1;
+  file->entries = (MSHR *) calloc(file->size, sizeof(MSHR));
+  file->stalls = stalls;
+}
+
+// Returns the in-flight miss for blockAddr at time t, or NULL
+static inline MSHR * findMSHR(MSHRFile * file, addr_t blockAddr, uint64_t t) {
+  for (int i = 0; i < file->size; i++) {
+    if (file->entries[i].ready > t && file->entries[i].blockAddr == blockAddr) {
+      return file->entries + i;
+    }
+  }
+  return NULL;
+}
+
+// Takes a free MSHR at time *t, moving *t forward to when one frees up
+// if the file is full
+static MSHR * allocMSHR(MSHRFile * file, addr_t blockAddr, uint64_t * t) {
+  MSHR * earliest = file->entries;
+
+  for (int i = 0; i < file->size; i++) {
+    if (file->entries[i].ready <= *t) {
+      earliest = file->entries + i;
+      break;
+    }
+    if (file->entries[i].ready < earliest->ready) {
+      earliest = file->entries + i;
+    }
+  }
+
+  if (earliest->ready > *t) {
+    *(file->stalls) += earliest->ready - *t;
+    *t = earliest->ready;
+  }
+  earliest->blockAddr = blockAddr;
+  return earliest;
+}
+
+void
+init_timing()
+{
+  timingCycles       = 0;
+  timingLatency      = 0;
+  overlappedLatency  = 0;
+  mshrMerges         = 0;
+  icacheMSHRStalls   = 0;
+  dcacheMSHRStalls   = 0;
+  l2cacheMSHRStalls  = 0;
+  memRequests        = 0;
+  memQueueDelay      = 0;
+  memQueueFullStalls = 0;
+  memQueueOccupancy  = 0;
+  memQueueMax        = 0;
+
+  createMSHRFile(&iMSHRFile, l1MSHRs, &icacheMSHRStalls);
+  createMSHRFile(&dMSHRFile, l1MSHRs, &dcacheMSHRStalls);
+  createMSHRFile(&l2MSHRFile, l2MSHRs, &l2cacheMSHRStalls);
+
+  if (memqueue == 0) {
+    memqueue = 1;
+  }
+  memDone = (uint64_t *) calloc(memqueue, sizeof(uint64_t));
+  memBusFree = 0;
+
+  cycle = 0;
+  timingBlockMask = ~(addr_t)(blocksize - 1);
+}
+
+// Returns the cycle at which a memory request arriving at *arrival
+// completes, moving *arrival forward to when the request enters a full
+// queue
+static uint64_t
+memory_timing(uint64_t * arrival)
+{
+  uint32_t occupancy = 0;
+  uint32_t earliest = 0;
+
+  memRequests++;
+
+  // Requests still in the queue when this one arrives
+  for (int i = 0; i < memqueue; i++) {
+    if (memDone[i] > *arrival) {
+      occupancy++;
+    }
+    if (memDone[i] < memDone[earliest]) {
+      earliest = i;
+    }
+  }
+  memQueueOccupancy += occupancy;
+  if (occupancy > memQueueMax) {
+    memQueueMax = occupancy;
+  }
+
+  // Wait for a slot in a full queue
+  if (memDone[earliest] > *arrival) {
+    memQueueFullStalls += memDone[earliest] - *arrival;
+    *arrival = memDone[earliest];
+  }
+
+  // Wait for the bus, which carries one block every membw cycles
+  uint64_t start = *arrival > memBusFree ? *arrival : memBusFree;
+  memQueueDelay += start - *arrival;
+  memBusFree = start + membw;
+
+  memDone[earliest] = start + memspeed;
+  return memDone[earliest];
+}
+
+// Returns the cycle at which an L2 access for blockAddr arriving at *t
+// completes, moving *t forward to when the first level it reaches can
+// take it
+static uint64_t
+l2_timing(addr_t blockAddr, uint64_t * t, uint32_t l2Hit)
+{
+  if (l2cacheSets == 0) {
+    return memory_timing(t);
+  }
+
+  MSHR * mshr = findMSHR(&l2MSHRFile, blockAddr, *t);
+  uint64_t done = *t + l2cacheHitTime;
+
+  // Hit under miss, or a second miss to a block already being fetched
+  if (mshr != NULL) {
+    mshrMerges++;
+    return mshr->ready > done ? mshr->ready : done;
+  }
+  if (l2Hit) {
+    return done;
+  }
+
+  // The MSHR holds the miss while it waits for the memory queue
+  mshr = allocMSHR(&l2MSHRFile, blockAddr, t);
+  uint64_t arrival = *t + l2cacheHitTime;
+  mshr->ready = memory_timing(&arrival);
+  return mshr->ready;
+}
+
+uint32_t
+timed_access(addr_t addr, char i_or_d)
+{
+  uint64_t l1MissesBefore = i_or_d == 'I' ? icacheMisses : dcacheMisses;
+  uint64_t l2MissesBefore = l2cacheMisses;
+  uint64_t memWritesBefore = memWrites;
+  uint32_t latency;
+  uint32_t l1Sets, l1HitTime;
+  MSHRFile * l1File;
+
+  if (i_or_d == 'I') {
+    latency = icache_access(addr);
+    l1Sets = icacheSets;
+    l1HitTime = icacheHitTime;
+    l1File = &iMSHRFile;
+  } else {
+    latency = i_or_d == 'W' ? dcache_write(addr) : dcache_access(addr);
+    l1Sets = dcacheSets;
+    l1HitTime = dcacheHitTime;
+    l1File = &dMSHRFile;
+  }
+
+  uint32_t l1Hit = (i_or_d == 'I' ? icacheMisses : dcacheMisses) == l1MissesBefore;
+  uint32_t l2Hit = l2cacheMisses == l2MissesBefore;
+  addr_t blockAddr = addr & timingBlockMask;
+  uint64_t issue = cycle;
+  uint64_t done;
+
+  // A store that does not allocate on a miss fetches no block; it is
+  // posted, and its memory write only takes the bus below
+  uint32_t posted = i_or_d == 'W' && !writeAllocate;
+
+  if (l1Sets == 0) {
+    if (i_or_d == 'W' && (l2cacheSets == 0 || (posted && !l2Hit))) {
+      done = issue + (l2cacheSets ? l2cacheHitTime : 0);
+    } else {
+      // The core stalls until the L2, or memory, takes the access
+      done = l2_timing(blockAddr, &issue, l2Hit);
+    }
+  } else if (posted && !l1Hit) {
+    done = issue + l1HitTime;
+  } else {
+    MSHR * mshr = findMSHR(l1File, blockAddr, issue);
+    done = issue + l1HitTime;
+
+    if (mshr != NULL) {
+      // Hit under miss, or a second miss to a block already being fetched
+      mshrMerges++;
+      if (mshr->ready > done) {
+        done = mshr->ready;
+      }
+    } else if (!l1Hit) {
+      // The core stalls until an MSHR is free
+      mshr = allocMSHR(l1File, blockAddr, &issue);
+      uint64_t arrival = issue + l1HitTime;
+      mshr->ready = l2_timing(blockAddr, &arrival, l2Hit);
+      done = mshr->ready;
+    }
+  }
+
+  // Blocks written to memory are posted, but still take the bus
+  for (uint64_t i = memWritesBefore; i < memWrites; i++) {
+    memBusFree = (memBusFree > issue ? memBusFree : issue) + membw;
+  }
+
+  timingLatency += done - cycle;
+  if (done > timingCycles) {
+    timingCycles = done;
+  }
+  cycle = issue + 1;
+
+  return latency;
+}
+
+void
+finish_timing()
+{
+  if (timingLatency > timingCycles) {
+    overlappedLatency = timingLatency - timingCycles;
+  }
+}
@@ -0,0 +1,63 @@
+//========================================================//
+//  timing.h                                              //
+//  Header file for the non-blocking timing model         //
+//                                                        //
+//  Optional cycle-level model with MSHRs and a memory    //
+//  bandwidth and queue limit, layered on top of the      //
+//  flat access times of the cache functions              //
+//========================================================//
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "cache.h"
+
+//------------------------------------//
+//        Timing Configuration        //
+//------------------------------------//
+
+extern uint32_t timingModel;    // Indicates if the timing model is enabled
+extern uint32_t l1MSHRs;        // MSHRs of each L1 cache
+extern uint32_t l2MSHRs;        // MSHRs of the L2 cache
+extern uint32_t membw;          // Cycles the memory bus is busy per block
+extern uint32_t memqueue;       // Memory requests that can be outstanding
+
+//------------------------------------//
+//          Timing Statistics         //
+//------------------------------------//
+
+extern uint64_t timingCycles;       // Cycles until the last access completed
+extern uint64_t timingLatency;      // Sum of the latencies of all accesses
+extern uint64_t overlappedLatency;  // Latency overlapped with other accesses
+extern uint64_t mshrMerges;         // Accesses merged into an in-flight miss
+extern uint64_t icacheMSHRStalls;   // Cycles stalled on a full I$ MSHR file
+extern uint64_t dcacheMSHRStalls;   // Cycles stalled on a full D$ MSHR file
+extern uint64_t l2cacheMSHRStalls;  // Cycles stalled on a full L2$ MSHR file
+extern uint64_t memRequests;        // Requests sent to main memory
+extern uint64_t memQueueDelay;      // Cycles requests waited for the memory bus
+extern uint64_t memQueueFullStalls; // Cycles requests waited for a queue slot
+extern uint64_t memQueueOccupancy;  // Sum of the queue occupancy seen by requests
+extern uint64_t memQueueMax;        // Highest queue occupancy seen
+
+//------------------------------------//
+//     Timing Function Prototypes     //
+//------------------------------------//
+
+// Initialize the timing model, after init_cache
+//
+void init_timing();
+
+// Perform a memory access for the address 'addr' through the I$ if
+// 'i_or_d' is 'I' and through the D$ otherwise, and advance the timing
+// model by one issued access
+// Return the flat access time for the memory operation
+//
+uint32_t timed_access(addr_t addr, char i_or_d);
+
+// Finish the timing model once all accesses have been issued
+//
+void finish_timing();
+
+#endif